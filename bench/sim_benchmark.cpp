@@ -0,0 +1,199 @@
+// Headless simulation benchmark, sweeps particle count x thread count x force
+// kernel and prints one result row per combination.
+// usage: sim_benchmark [--counts 1000,4000] [--threads 1,2,4] [--kernels scalar,sse]
+//                      [--steps 200] [--warmup 20] [--format csv|json] [--out file]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/engine/logger.h"
+#include "../src/simulation/simulation.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+dazai_engine::logger g_logger("sim_benchmark_log.txt");
+
+namespace
+{
+	struct benchmark_result
+	{
+		uint32_t count;
+		uint32_t threads;
+		const char* kernel;
+		uint32_t steps;
+		double seconds;
+		double steps_per_second;
+		double ns_per_particle;
+		uint64_t sim_bytes;
+		uint64_t peak_rss_bytes;
+	};
+
+	auto parse_list(const char* text) -> std::vector<uint32_t>
+	{
+		std::vector<uint32_t> values;
+		while (*text)
+		{
+			char* end;
+			values.push_back((uint32_t)strtoul(text, &end, 10));
+			text = *end == ',' ? end + 1 : end;
+			if (end == text && *text)
+				break;
+		}
+		return values;
+	}
+
+	auto parse_kernels(const char* text) -> std::vector<force_kernel_type>
+	{
+		const force_kernel_type all[] = { force_kernel_type::scalar, force_kernel_type::sse,
+			force_kernel_type::avx2, force_kernel_type::neon };
+		std::vector<force_kernel_type> kernels;
+		for (force_kernel_type type : all)
+		{
+			const char* name = force_kernel_name(type);
+			bool wanted = strcmp(text, "all") == 0 || strstr(text, name) != nullptr;
+			//variants not built for this cpu are skipped instead of failing the sweep
+			if (wanted && get_force_kernel(type) != nullptr)
+				kernels.push_back(type);
+		}
+		return kernels;
+	}
+
+	auto peak_rss_bytes() -> uint64_t
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return (uint64_t)usage.ru_maxrss;
+#else
+		return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	auto run(uint32_t count, uint32_t threads, force_kernel_type kernel,
+		uint32_t warmup, uint32_t steps) -> benchmark_result
+	{
+		//the calling thread takes part, n threads = n - 1 pool workers
+		std::unique_ptr<dazai_engine::thread_pool> pool;
+		if (threads > 1)
+			pool = std::make_unique<dazai_engine::thread_pool>(threads - 1);
+		simulation_state state{};
+		//the constructor spawns half the initial capacity
+		simulation sim(&state, nullptr, pool.get(), count * 2);
+		sim.set_force_kernel(kernel);
+		const float step_dt = 1.0f / DEFAULT_SIM_RATE_HZ;
+		for (uint32_t s = 0; s < warmup; s++)
+			sim.update(step_dt);
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t s = 0; s < steps; s++)
+			sim.update(step_dt);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		benchmark_result result{};
+		result.count = state.entity_count;
+		result.threads = threads;
+		result.kernel = force_kernel_name(kernel);
+		result.steps = steps;
+		result.seconds = seconds;
+		result.steps_per_second = seconds > 0.0 ? steps / seconds : 0.0;
+		result.ns_per_particle = steps > 0 && state.entity_count > 0 ?
+			seconds * 1e9 / ((double)steps * state.entity_count) : 0.0;
+		result.sim_bytes = sim.memory_bytes();
+		result.peak_rss_bytes = peak_rss_bytes();
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	//results go to stdout, keep the logger's console output to errors
+	g_logger.set_level(dazai_engine::LogLevel::error);
+
+	uint32_t hw = std::thread::hardware_concurrency();
+	std::vector<uint32_t> counts = { 1000, 2000, 4000, 8000 };
+	std::vector<uint32_t> thread_counts = { 1, 2, 4 };
+	if (hw > 4)
+		thread_counts.push_back(hw);
+	std::vector<force_kernel_type> kernels = parse_kernels("all");
+	uint32_t steps = 200;
+	uint32_t warmup = 20;
+	bool json = false;
+	const char* out_path = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--counts") == 0 && has_value)
+			counts = parse_list(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && has_value)
+			thread_counts = parse_list(argv[++i]);
+		else if (strcmp(argv[i], "--kernels") == 0 && has_value)
+			kernels = parse_kernels(argv[++i]);
+		else if (strcmp(argv[i], "--steps") == 0 && has_value)
+			steps = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--warmup") == 0 && has_value)
+			warmup = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--format") == 0 && has_value)
+			json = strcmp(argv[++i], "json") == 0;
+		else if (strcmp(argv[i], "--out") == 0 && has_value)
+			out_path = argv[++i];
+		else
+		{
+			fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 1;
+		}
+	}
+	FILE* out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out)
+	{
+		fprintf(stderr, "can't open %s\n", out_path);
+		return 1;
+	}
+
+	if (json)
+		fprintf(out, "{\"hardware_threads\":%u,\"results\":[", hw);
+	else
+		fprintf(out, "count,threads,kernel,steps,seconds,steps_per_second,ns_per_particle,sim_bytes,peak_rss_bytes\n");
+	bool first = true;
+	for (uint32_t count : counts)
+	{
+		for (uint32_t threads : thread_counts)
+		{
+			for (force_kernel_type kernel : kernels)
+			{
+				benchmark_result r = run(count, threads > 0 ? threads : 1, kernel, warmup, steps);
+				if (json)
+					fprintf(out, "%s\n{\"count\":%u,\"threads\":%u,\"kernel\":\"%s\",\"steps\":%u,"
+						"\"seconds\":%.6f,\"steps_per_second\":%.3f,\"ns_per_particle\":%.3f,"
+						"\"sim_bytes\":%llu,\"peak_rss_bytes\":%llu}",
+						first ? "" : ",", r.count, r.threads, r.kernel, r.steps, r.seconds,
+						r.steps_per_second, r.ns_per_particle,
+						(unsigned long long)r.sim_bytes, (unsigned long long)r.peak_rss_bytes);
+				else
+					fprintf(out, "%u,%u,%s,%u,%.6f,%.3f,%.3f,%llu,%llu\n",
+						r.count, r.threads, r.kernel, r.steps, r.seconds,
+						r.steps_per_second, r.ns_per_particle,
+						(unsigned long long)r.sim_bytes, (unsigned long long)r.peak_rss_bytes);
+				fflush(out);
+				first = false;
+			}
+		}
+	}
+	if (json)
+		fprintf(out, "\n]}\n");
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
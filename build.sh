@@ -0,0 +1,14 @@
+#!/bin/sh
+# Linux build, needs cmake, a c++20 compiler, the vulkan + glfw dev packages
+# and glslc or glslangValidator for the shaders, without one the gpu
+# particle solver (--gpu-sim) is left out
+set -e
+
+BUILD_DIR=build
+BUILD_TYPE=${1:-Release}
+
+mkdir -p "$BUILD_DIR"
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE="$BUILD_TYPE"
+cmake --build "$BUILD_DIR" -j"$(nproc)"
+
+echo "Build completed: $BUILD_DIR/DazaiVulkan"
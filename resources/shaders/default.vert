@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 #include "../../src/engine/shared_structs.h"
 
 layout(set =0, binding = 0) uniform global_ubo
@@ -0,0 +1,115 @@
+#include "asset_pack.h"
+#include <cstring>
+#include "logger.h"
+#include "lz4_block.h"
+
+using namespace dazai_engine::asset_pack_format;
+
+auto dazai_engine::asset_pack::open(const char* path) -> bool
+{
+	close();
+	if (!m_file.open(path))
+	{
+		LOG_ERROR("Failed to map asset pack:", path);
+		return false;
+	}
+	uint64_t file_size = m_file.size();
+	const header* pack_header = (const header*)m_file.data();
+	if (file_size < sizeof(header) || memcmp(pack_header->magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		LOG_ERROR("Not an asset pack:", path);
+		m_file.close();
+		return false;
+	}
+	if (pack_header->version != VERSION)
+	{
+		LOG_ERROR("Asset pack version", pack_header->version, "expected", VERSION, path);
+		m_file.close();
+		return false;
+	}
+	//power of two slot count with room to spare, or probing may never end
+	uint32_t slot_count = pack_header->slot_count;
+	bool valid = slot_count > 0 && (slot_count & (slot_count - 1)) == 0 &&
+		pack_header->entry_count < slot_count &&
+		pack_header->slots_offset % alignof(slot) == 0 &&
+		pack_header->slots_offset <= file_size &&
+		(file_size - pack_header->slots_offset) / sizeof(slot) >= slot_count &&
+		pack_header->names_offset <= file_size &&
+		file_size - pack_header->names_offset >= pack_header->names_size;
+	const slot* slots = (const slot*)(m_file.data() + pack_header->slots_offset);
+	uint32_t used = 0;
+	for (uint32_t s = 0; valid && s < slot_count; s++)
+	{
+		const slot& entry = slots[s];
+		if (entry.name_hash == 0)
+			continue;
+		used++;
+		valid = (uint64_t)entry.name_offset + entry.name_length <= pack_header->names_size &&
+			entry.offset <= file_size && file_size - entry.offset >= entry.stored_size &&
+			(entry.compression == compression_lz4 ||
+				(entry.compression == compression_none && entry.stored_size == entry.size));
+	}
+	if (!valid || used != pack_header->entry_count)
+	{
+		LOG_ERROR("Asset pack table of contents is corrupt:", path);
+		m_file.close();
+		return false;
+	}
+	m_header = pack_header;
+	m_slots = slots;
+	m_names = (const char*)m_file.data() + pack_header->names_offset;
+	LOG_INFO("Asset pack mounted:", path, "assets:", pack_header->entry_count);
+	return true;
+}
+
+auto dazai_engine::asset_pack::close() -> void
+{
+	m_file.close();
+	m_header = nullptr;
+	m_slots = nullptr;
+	m_names = nullptr;
+}
+
+auto dazai_engine::asset_pack::find(std::string_view name) const -> const slot*
+{
+	if (!m_header)
+		return nullptr;
+	uint64_t hash = hash_name(name);
+	uint32_t mask = m_header->slot_count - 1;
+	//at least one slot is empty, open() checked entry_count < slot_count
+	for (uint32_t s = (uint32_t)hash & mask;; s = (s + 1) & mask)
+	{
+		const slot& entry = m_slots[s];
+		if (entry.name_hash == 0)
+			return nullptr;
+		if (entry.name_hash == hash && slot_name(entry) == name)
+			return &entry;
+	}
+}
+
+auto dazai_engine::asset_pack::read(std::string_view name, std::vector<uint8_t>* storage,
+	std::span<const uint8_t>* out) const -> bool
+{
+	const slot* entry = find(name);
+	if (!entry)
+		return false;
+	const uint8_t* blob = m_file.data() + entry->offset;
+	if (entry->compression == compression_none)
+	{
+		*out = { blob, entry->size };
+		return true;
+	}
+	storage->resize(entry->size);
+	if (!lz4_block::decompress(blob, entry->stored_size, storage->data(), entry->size))
+	{
+		LOG_ERROR("Corrupt asset in pack:", std::string(name));
+		return false;
+	}
+	*out = { storage->data(), storage->size() };
+	return true;
+}
+
+auto dazai_engine::asset_pack::slot_name(const slot& entry) const -> std::string_view
+{
+	return { m_names + entry.name_offset, entry.name_length };
+}
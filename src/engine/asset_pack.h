@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "asset_pack_format.h"
+#include "mapped_file.h"
+
+namespace dazai_engine
+{
+	//read only view of a pack written by tools/asset_packer. the whole pack
+	//is mapped once, lookups hash the name and probe the slot table so they
+	//cost the same no matter how many assets there are. const member
+	//functions may be called from any thread
+	class asset_pack
+	{
+	public:
+		//path is used as is. checks the header and that every slot's name and
+		//blob lie inside the file, so later reads can trust the table
+		auto open(const char* path) -> bool;
+		auto close() -> void;
+		auto is_open() const -> bool { return m_header != nullptr; }
+		auto entry_count() const -> uint32_t { return m_header ? m_header->entry_count : 0; }
+		//null if the pack has no asset with that name
+		auto find(std::string_view name) const -> const asset_pack_format::slot*;
+		//uncompressed assets point into the mapping, lz4 ones are
+		//decompressed into storage. out is valid while both are alive
+		auto read(std::string_view name, std::vector<uint8_t>* storage,
+			std::span<const uint8_t>* out) const -> bool;
+
+	private:
+		auto slot_name(const asset_pack_format::slot& slot) const -> std::string_view;
+
+		mapped_file m_file;
+		const asset_pack_format::header* m_header{ nullptr };
+		const asset_pack_format::slot* m_slots{ nullptr };
+		const char* m_names{ nullptr };
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+//on disk layout of an asset pack, shared by asset_pack and tools/asset_packer.
+//everything is little endian, the file is
+//  header
+//  slot_count slots, an open addressing hash table keyed by name_hash
+//  names, the asset names back to back, not null terminated
+//  blobs, each starting on a multiple of header.alignment
+//a name is looked up by hashing it, starting at slot hash & (slot_count - 1)
+//and probing forward until the hash and name match or an empty slot is hit.
+//slot_count is a power of two at least twice the entry count, so probes stay short
+namespace dazai_engine
+{
+	namespace asset_pack_format
+	{
+		constexpr char MAGIC[8] = { 'D', 'Z', 'P', 'A', 'C', 'K', '1', '\n' };
+		constexpr uint32_t VERSION = 1;
+		//keeps spir-v word aligned and blobs on their own cache lines
+		constexpr uint32_t DEFAULT_ALIGNMENT = 64;
+
+		enum compression : uint8_t
+		{
+			compression_none = 0,
+			//lz4 block format, no frame, size holds the decompressed size
+			compression_lz4 = 1
+		};
+
+		struct header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t entry_count;
+			uint32_t slot_count;
+			uint32_t alignment;
+			uint64_t slots_offset;
+			uint64_t names_offset;
+			uint64_t names_size;
+		};
+
+		struct slot
+		{
+			//0 = empty slot
+			uint64_t name_hash;
+			uint64_t offset;
+			//bytes in the pack, equal to size when stored uncompressed
+			uint64_t stored_size;
+			uint64_t size;
+			//into the names block
+			uint32_t name_offset;
+			uint16_t name_length;
+			uint8_t compression;
+			uint8_t reserved;
+		};
+
+		static_assert(sizeof(header) == 48, "asset pack header layout changed");
+		static_assert(sizeof(slot) == 40, "asset pack slot layout changed");
+
+		//fnv-1a, 0 is reserved for empty slots
+		constexpr auto hash_name(std::string_view name) -> uint64_t
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (char c : name)
+			{
+				hash ^= (uint8_t)c;
+				hash *= 1099511628211ull;
+			}
+			return hash != 0 ? hash : 1;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+//on disk layout of the binary log, shared by the logger and tools/log_decoder.
+//everything is little endian, the file is
+//  MAGIC
+//  records, each starting with a record_tag byte:
+//  site_record: u32 id, u8 level, u32 line, u16 file length, file bytes
+//  log_record:  u32 site id, u8 arg count, then per arg an arg_type byte and
+//               8 bytes (int, uint, double, pointer) or u32 length + bytes (string)
+//  drop_record: u64 records lost since the previous drop_record
+//a site_record is written once per call site, the first time it logs. records
+//from other threads can land before it, decoders need the whole file
+namespace dazai_engine
+{
+	namespace binary_log
+	{
+		constexpr char MAGIC[8] = { 'D', 'Z', 'L', 'O', 'G', 'B', '1', '\n' };
+
+		enum record_tag : uint8_t
+		{
+			site_record = 1,
+			log_record = 2,
+			drop_record = 3
+		};
+
+		enum arg_type : uint8_t
+		{
+			arg_int = 1,
+			arg_uint = 2,
+			arg_double = 3,
+			arg_string = 4,
+			arg_pointer = 5
+		};
+	}
+}
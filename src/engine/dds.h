@@ -1,6 +1,34 @@
 #pragma once
 #include "defines.h"
 
+//"DDS " little endian
+uint32_t constexpr DDS_MAGIC = 0x20534444;
+uint32_t constexpr DDS_HEADER_SIZE = 124;
+uint32_t constexpr DDS_PIXEL_FORMAT_SIZE = 32;
+//DDSPixelFormat::dwFlags
+uint32_t constexpr DDPF_ALPHAPIXELS = 0x1;
+uint32_t constexpr DDPF_FOURCC = 0x4;
+uint32_t constexpr DDPF_RGB = 0x40;
+//DDSHeader::Flags, MipMapCount is only valid with it
+uint32_t constexpr DDSD_MIPMAPCOUNT = 0x20000;
+//ddspf.dwFourCC codes, little endian
+uint32_t constexpr DDS_FOURCC_DXT1 = 0x31545844;
+uint32_t constexpr DDS_FOURCC_DXT5 = 0x35545844;
+uint32_t constexpr DDS_FOURCC_DX10 = 0x30315844;
+//DXGI_FORMAT values the loader understands in a DX10 header
+uint32_t constexpr DXGI_FORMAT_R8G8B8A8_UNORM = 28;
+uint32_t constexpr DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29;
+uint32_t constexpr DXGI_FORMAT_BC1_UNORM = 71;
+uint32_t constexpr DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+uint32_t constexpr DXGI_FORMAT_BC3_UNORM = 77;
+uint32_t constexpr DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+uint32_t constexpr DXGI_FORMAT_B8G8R8A8_UNORM = 87;
+uint32_t constexpr DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91;
+uint32_t constexpr DXGI_FORMAT_BC7_UNORM = 98;
+uint32_t constexpr DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+//full chain of a 64k texture
+uint32_t constexpr DDS_MAX_MIPS = 17;
+
 struct DDSPixelFormat
 {
     uint32_t dwSize;
@@ -31,9 +59,48 @@ struct DDSHeader
     uint32_t Reserved2;
 };
 
-struct DDSFile
+//follows DDSHeader when ddspf.dwFourCC is DX10
+struct DDSHeaderDX10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+enum class dds_format
+{
+    rgba8,
+    bgra8,
+    //4x4 blocks, 8 bytes
+    bc1,
+    //4x4 blocks, 16 bytes
+    bc3,
+    bc7
+};
+
+struct dds_mip
+{
+    //from pixels
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+//a validated dds inside a file mapping, pointers are into the mapping
+struct dds_texture
 {
-    char magic[4];
-    DDSHeader header;
-    char dataBegin;
+    const DDSHeader* header;
+    uint32_t width;
+    uint32_t height;
+    dds_format format;
+    bool srgb;
+    //mips are stored largest first, tightly packed
+    uint32_t mip_count;
+    dds_mip mips[DDS_MAX_MIPS];
+    //pixel data of every stored surface, right after the header(s)
+    const uint8_t* pixels;
+    uint64_t pixel_bytes;
 };
\ No newline at end of file
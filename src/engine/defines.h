@@ -2,5 +2,10 @@
 #include <cstdint>
 
 #define KB(x) ((uint64_t)1024 * x)
-#define MB(x) ((uint64_t)1024 * KB(1))
-#define GB(x) ((uint64_t)1024 * MB(1))
\ No newline at end of file
+#define MB(x) ((uint64_t)1024 * KB(x))
+#define GB(x) ((uint64_t)1024 * MB(x))
+
+//windows.h provides this on msvc builds
+#ifndef ARRAYSIZE
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
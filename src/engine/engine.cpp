@@ -1,38 +1,294 @@
 #include "engine.h"
 #include "logger.h"
+#include "profiler.h"
 #include "../simulation/simulation.h"
 #include "timer.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
 
-dazai_engine::engine::engine()
+namespace
 {
-	m_glfw_window = new glfw_window();
-	m_renderer = new renderer(m_glfw_window);
+	auto publish_state(dazai_engine::triple_buffer<dazai_engine::published_state>& states,
+		const simulation_state& s_state) -> void
+	{
+		dazai_engine::published_state& out = states.write_buffer();
+		if (!out.state.particles.copy_render_data(s_state.particles, s_state.entity_count))
+		{
+			LOG_ERROR("Failed to copy simulation state, entities:", s_state.entity_count);
+			return;
+		}
+		out.state.entity_count = s_state.entity_count;
+		out.step_time = std::chrono::steady_clock::now();
+		states.publish();
+	}
+}
+
+dazai_engine::engine::engine(engine_config config):
+	m_config(config)
+{
+#if !GPU_SIMULATION_AVAILABLE
+	if (m_config.gpu_simulation)
+	{
+		LOG_WARNING("GPU particle solver not built, particles.comp.spv was missing at configure time");
+		m_config.gpu_simulation = false;
+	}
+#endif
+	renderer_config r_config{};
+	r_config.headless = m_config.headless;
+	r_config.gpu_simulation = m_config.gpu_simulation;
+	r_config.pipeline_cache_path = m_config.pipeline_cache_path;
+	//headless machines have no display to open a window on
+	m_glfw_window = m_config.headless ? nullptr : new glfw_window();
+	m_renderer = new renderer(m_glfw_window, r_config);
+	m_thread_pool = new thread_pool();
+	LOG_INFO("Worker threads:", m_thread_pool->worker_count());
 }
 
 dazai_engine::engine::~engine()
 {
 	delete m_glfw_window;
 	delete m_renderer;
+	delete m_thread_pool;
 }
 
-auto dazai_engine::engine::update() -> void
+auto dazai_engine::engine::update() -> bool
 {
-	
+	profiler::set_thread_name("main");
+	m_last_profile_report = profiler::now_ns();
+	//the renderer drops the gpu solver when it can't be set up, the check
+	//must not pass by running the cpu solver alone
+	if (m_config.gpu_cross_check && !m_renderer->gpu_simulation_enabled())
+	{
+		LOG_ERROR("GPU solver cross check could not run");
+		return false;
+	}
+	if (m_renderer->gpu_simulation_enabled() && update_gpu())
+	{
+		report_profile(true);
+		return !m_check_failed;
+	}
+	if (m_config.headless)
+	{
+		update_headless();
+		report_profile(true);
+		return !m_check_failed;
+	}
+	//owned by the simulation thread, the renderer only sees published copies
 	simulation_state s_state{};
-	simulation simulation(&s_state,m_glfw_window->window);
+	simulation simulation(&s_state,m_glfw_window->window,m_thread_pool,m_config.entity_capacity);
+	triple_buffer<published_state> states;
+	publish_state(states, s_state);
+	//fixed step accumulator, the sim advances in whole steps of step_dt
+	//and render interpolates between the last two of them
+	const float step_dt = 1.0f / (m_config.sim_rate_hz > 0 ? m_config.sim_rate_hz : DEFAULT_SIM_RATE_HZ);
+	std::atomic<bool> running{ true };
+	std::thread sim_thread([&]()
+		{
+			profiler::set_thread_name("simulation");
+			float accumulator = 0.0f;
+			//drop the time spent in init
+			timer::get_delta_time();
+			while (running.load(std::memory_order_relaxed))
+			{
+				accumulator += timer::get_delta_time();
+				uint32_t substeps = 0;
+				while (accumulator >= step_dt && substeps < m_config.max_substeps)
+				{
+					simulation.update(step_dt);
+					accumulator -= step_dt;
+					substeps++;
+				}
+				//can't keep up, let the sim run slow instead of piling up steps
+				if (accumulator >= step_dt)
+					accumulator = std::fmod(accumulator, step_dt);
+				if (substeps > 0)
+					publish_state(states, s_state);
+				//nothing to do until the next step is due
+				std::this_thread::sleep_for(std::chrono::duration<float>(step_dt - accumulator));
+			}
+		});
 
 	while (m_glfw_window->is_running())
 	{
-		//update simulation
-		simulation.update();
+		PROFILE_ZONE("frame");
+		//newest completed step, stays untouched by the sim until the next consume
+		states.consume();
+		published_state& latest = states.read_buffer();
+		//the state became current at step_time, blend towards it over one step
+		float since_step = std::chrono::duration<float>(
+			std::chrono::steady_clock::now() - latest.step_time).count();
+		float interpolation = since_step / step_dt;
+		latest.state.interpolation = interpolation < 1.0f ? interpolation : 1.0f;
 		//render loop
-		bool success = m_renderer->render(&s_state);
+		bool success = m_renderer->render(&latest.state);
 		if (!success)
 		{
 			LOG_ERROR("Render loop failed");
 		}
 		//event polling
 		glfwPollEvents();
+		report_profile(false);
+	}
+	running.store(false, std::memory_order_relaxed);
+	sim_thread.join();
+	report_profile(true);
+	return !m_check_failed;
+}
+
+auto dazai_engine::engine::update_headless() -> void
+{
+	simulation_state s_state{};
+	simulation simulation(&s_state,nullptr,m_thread_pool,m_config.entity_capacity);
+	//one fixed step per frame so runs are repeatable regardless of frame time
+	const float step_dt = 1.0f / (m_config.sim_rate_hz > 0 ? m_config.sim_rate_hz : DEFAULT_SIM_RATE_HZ);
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < m_config.headless_frames; frame++)
+	{
+		PROFILE_ZONE("frame");
+		simulation.update(step_dt);
+		if (m_config.capture_path && frame + 1 == m_config.headless_frames)
+			m_renderer->capture_frame(m_config.capture_path);
+		if (!m_renderer->render(&s_state))
+		{
+			LOG_ERROR("Render loop failed");
+			return;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	double total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+	//asked for with --headless, so it goes to stdout whatever the log level
+	g_logger.flush();
+	printf("Headless frames: %u entities: %u total ms: %.3f ms per frame: %.3f\n",
+		m_config.headless_frames, s_state.entity_count, total_ms,
+		m_config.headless_frames > 0 ? total_ms / m_config.headless_frames : 0.0);
+}
+
+auto dazai_engine::engine::update_gpu() -> bool
+{
+	//the cpu simulation only spawns the starting particles and computes the
+	//per step constants, the particles themselves live on the gpu from here
+	simulation_state s_state{};
+	simulation simulation(&s_state, m_glfw_window ? m_glfw_window->window : nullptr,
+		m_thread_pool, m_config.entity_capacity);
+	if (!m_renderer->seed_gpu_particles(&s_state, simulation::interaction_radius()))
+	{
+		LOG_WARNING("GPU solver unavailable, using the CPU solver");
+		if (m_config.gpu_cross_check)
+		{
+			LOG_ERROR("GPU solver cross check could not run");
+			m_check_failed = true;
+		}
+		return false;
+	}
+	const float step_dt = 1.0f / (m_config.sim_rate_hz > 0 ? m_config.sim_rate_hz : DEFAULT_SIM_RATE_HZ);
+	if (m_config.gpu_cross_check)
+	{
+		//same start positions and constants on both, the cpu one is the reference
+		m_renderer->queue_gpu_step(simulation.gpu_step_params(step_dt));
+		std::vector<transform> gpu_particles;
+		if (m_renderer->render(&s_state) && m_renderer->read_gpu_particles(gpu_particles))
+		{
+			simulation.update(step_dt);
+			float max_error = 0.0f;
+			uint32_t mismatches = 0;
+			for (uint32_t i = 0; i < s_state.entity_count; i++)
+			{
+				float error_x = std::fabs(gpu_particles[i].x - s_state.particles.x[i]);
+				float error_y = std::fabs(gpu_particles[i].y - s_state.particles.y[i]);
+				//a nan on either axis is a mismatch, fmax alone would drop it
+				float error = std::isnan(error_x) || std::isnan(error_y) ? NAN : std::fmax(error_x, error_y);
+				if (!(error <= m_config.gpu_cross_check_tolerance))
+					mismatches++;
+				if (error > max_error || std::isnan(error))
+					max_error = error;
+			}
+			g_logger.flush();
+			printf("GPU solver cross check, entities: %u max error: %g tolerance: %g mismatches: %u\n",
+				s_state.entity_count, max_error, m_config.gpu_cross_check_tolerance, mismatches);
+			if (mismatches > 0)
+			{
+				LOG_ERROR("GPU solver disagrees with the CPU solver, particles:", mismatches,
+					"max error:", max_error);
+				m_check_failed = true;
+			}
+		}
+		else
+		{
+			LOG_ERROR("GPU solver cross check failed");
+			m_check_failed = true;
+		}
+	}
+
+	if (m_config.headless)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < m_config.headless_frames; frame++)
+		{
+			PROFILE_ZONE("frame");
+			m_renderer->queue_gpu_step(simulation.gpu_step_params(step_dt));
+			if (m_config.capture_path && frame + 1 == m_config.headless_frames)
+				m_renderer->capture_frame(m_config.capture_path);
+			if (!m_renderer->render(&s_state))
+			{
+				LOG_ERROR("Render loop failed");
+				return true;
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		double total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+		g_logger.flush();
+		printf("Headless GPU solver frames: %u entities: %u total ms: %.3f ms per frame: %.3f\n",
+			m_config.headless_frames, s_state.entity_count, total_ms,
+			m_config.headless_frames > 0 ? total_ms / m_config.headless_frames : 0.0);
+		return true;
+	}
+
+	//steps are recorded into the frame's command buffer, so there is no sim
+	//thread and nothing to interpolate, every frame shows the newest step
+	float accumulator = 0.0f;
+	timer::get_delta_time();
+	while (m_glfw_window->is_running())
+	{
+		PROFILE_ZONE("frame");
+		accumulator += timer::get_delta_time();
+		uint32_t substeps = 0;
+		while (accumulator >= step_dt && substeps < m_config.max_substeps)
+		{
+			m_renderer->queue_gpu_step(simulation.gpu_step_params(step_dt));
+			accumulator -= step_dt;
+			substeps++;
+		}
+		if (accumulator >= step_dt)
+			accumulator = std::fmod(accumulator, step_dt);
+		if (!m_renderer->render(&s_state))
+		{
+			LOG_ERROR("Render loop failed");
+		}
+		glfwPollEvents();
+		report_profile(false);
+	}
+	return true;
+}
+
+auto dazai_engine::engine::report_profile(bool final) -> void
+{
+	const double report_seconds = 5.0;
+	uint64_t now = profiler::now_ns();
+	if (!final && now - m_last_profile_report < (uint64_t)(report_seconds * 1e9))
+		return;
+	//the final report covers the whole run since the last one
+	double window = (now - m_last_profile_report) / 1e9;
+	m_last_profile_report = now;
+	if (m_config.profile)
+	{
+		g_logger.flush();
+		profiler::print_summary(final ? window : report_seconds);
+	}
+	if (final && m_config.trace_path)
+	{
+		if (profiler::write_chrome_trace(m_config.trace_path))
+			printf("Trace written: %s\n", m_config.trace_path);
 	}
-	
 }
@@ -1,16 +1,73 @@
 #pragma once
 #include "glfw_window.h"
 #include "renderer.h"
+#include "thread_pool.h"
+#include "triple_buffer.h"
+#include <chrono>
+
+//0 when the build had no shader compiler to produce particles.comp.spv,
+//--gpu-sim then stays on the cpu solver
+#ifndef GPU_SIMULATION_AVAILABLE
+#define GPU_SIMULATION_AVAILABLE 1
+#endif
+
 namespace dazai_engine
 {
+	//a completed simulation step handed from the simulation thread to the renderer
+	struct published_state
+	{
+		simulation_state state{};
+		std::chrono::steady_clock::time_point step_time{};
+	};
+
+	struct engine_config
+	{
+		//sizes the initial simulation storage, it grows on demand
+		uint32_t entity_capacity{ DEFAULT_ENTITY_CAPACITY };
+		//fixed simulation rate, rendering runs at whatever rate the display allows
+		uint32_t sim_rate_hz{ DEFAULT_SIM_RATE_HZ };
+		//most sim steps per rendered frame, beyond that the sim slows down
+		//instead of spending ever longer frames catching up
+		uint32_t max_substeps{ 5 };
+		//no window, render offscreen for headless_frames frames then return
+		bool headless{ false };
+		uint32_t headless_frames{ 1000 };
+		//ppm of the last headless frame, null = no capture
+		const char* capture_path{ nullptr };
+		//step the particles in a compute shader instead of on the cpu,
+		//falls back to the cpu solver when the gpu one can't be set up
+		bool gpu_simulation{ false };
+		//run the first step on both solvers, update() fails if any particle
+		//ends up further apart than the tolerance, in pixels
+		bool gpu_cross_check{ false };
+		float gpu_cross_check_tolerance{ 0.05f };
+		//print per zone min/avg/p99 timings every few seconds and at the end
+		bool profile{ false };
+		//chrome trace json of the last profiled events, written on exit
+		const char* trace_path{ nullptr };
+		//driver pipeline cache kept across runs, null = compile from scratch
+		const char* pipeline_cache_path{ DEFAULT_PIPELINE_CACHE_PATH };
+	};
+
 	class engine
 	{
 	public:
-		engine();
+		engine(engine_config config = {});
 		~engine();
-		auto update() -> void;
+		//false if a check the config asked for failed
+		auto update() -> bool;
 	private:
+		auto update_headless() -> void;
+		//false if the gpu solver couldn't be seeded and nothing was run
+		auto update_gpu() -> bool;
+		//every few seconds while running, once more on exit
+		auto report_profile(bool final) -> void;
+
 		renderer* m_renderer;
 		glfw_window* m_glfw_window;
+		thread_pool* m_thread_pool;
+		engine_config m_config;
+		uint64_t m_last_profile_report{ 0 };
+		bool m_check_failed{ false };
 	};
 }
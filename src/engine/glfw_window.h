@@ -1,4 +1,7 @@
 #pragma once 
+//declares glfwCreateWindowSurface, has to be set before glfw3.h
+//is included anywhere else in the translation unit
+#define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <stdexcept>
 
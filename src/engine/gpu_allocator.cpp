@@ -0,0 +1,272 @@
+#include "gpu_allocator.h"
+#include "logger.h"
+
+auto dazai_engine::gpu_allocator::init(VkDevice device, VkPhysicalDevice physical_device,
+	VkDeviceSize block_size) -> void
+{
+	m_device = device;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &m_mem_props);
+	VkPhysicalDeviceProperties props{};
+	vkGetPhysicalDeviceProperties(physical_device, &props);
+	m_max_allocation_count = props.limits.maxMemoryAllocationCount;
+	//blocks are one buddy tree, keep them a power of two
+	m_block_order = order_of(block_size);
+	m_block_size = (VkDeviceSize)1 << m_block_order;
+}
+
+auto dazai_engine::gpu_allocator::destroy() -> void
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& pool : m_pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block.memory == VK_NULL_HANDLE)
+				continue;
+			if (block.mapped)
+				vkUnmapMemory(m_device, block.memory);
+			vkFreeMemory(m_device, block.memory, 0);
+		}
+	}
+	m_pools.clear();
+}
+
+auto dazai_engine::gpu_allocator::allocate(VkMemoryRequirements mem_reqs,
+	VkMemoryPropertyFlags mem_props, bool linear) -> gpu_allocation
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	gpu_allocation allocation{};
+	uint32_t memory_type = find_memory_type(mem_reqs.memoryTypeBits, mem_props);
+	if (memory_type == UINT32_MAX)
+	{
+		LOG_ERROR("Memory index Invalid");
+		return allocation;
+	}
+	uint32_t pool_index = find_pool(memory_type, linear);
+	memory_pool& pool = m_pools[pool_index];
+	//a buddy range is aligned to its own size, so asking for at least
+	//the alignment is enough to satisfy it
+	VkDeviceSize size = mem_reqs.size > mem_reqs.alignment ? mem_reqs.size : mem_reqs.alignment;
+	uint32_t order = order_of(size);
+
+	int32_t block_index = -1;
+	VkDeviceSize offset = 0;
+	if (order > m_block_order)
+	{
+		//bigger than a whole block, give it its own memory
+		block_index = create_block(pool, mem_reqs.size, true);
+	}
+	else
+	{
+		for (size_t b = 0; b < pool.blocks.size(); b++)
+		{
+			memory_block& block = pool.blocks[b];
+			if (block.memory == VK_NULL_HANDLE || block.dedicated)
+				continue;
+			offset = buddy_alloc(block, order);
+			if (offset != UINT64_MAX)
+			{
+				block_index = (int32_t)b;
+				break;
+			}
+		}
+		if (block_index < 0)
+		{
+			block_index = create_block(pool, m_block_size, false);
+			if (block_index >= 0)
+				offset = buddy_alloc(pool.blocks[block_index], order);
+		}
+	}
+	if (block_index < 0)
+		return allocation;
+
+	memory_block& block = pool.blocks[block_index];
+	block.allocation_count++;
+	block.bytes_used += mem_reqs.size;
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = mem_reqs.size;
+	allocation.data = block.mapped ? (char*)block.mapped + offset : nullptr;
+	allocation.pool = pool_index;
+	allocation.block = (uint32_t)block_index;
+	allocation.order = order;
+	return allocation;
+}
+
+auto dazai_engine::gpu_allocator::free(gpu_allocation* allocation) -> void
+{
+	if (allocation->memory == VK_NULL_HANDLE)
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	memory_block& block = m_pools[allocation->pool].blocks[allocation->block];
+	block.allocation_count--;
+	block.bytes_used -= allocation->size;
+	if (block.dedicated)
+	{
+		if (block.mapped)
+			vkUnmapMemory(m_device, block.memory);
+		vkFreeMemory(m_device, block.memory, 0);
+		//slot gets reused by the next create_block
+		block = {};
+	}
+	else
+	{
+		buddy_free(block, allocation->offset, allocation->order);
+	}
+	*allocation = {};
+}
+
+auto dazai_engine::gpu_allocator::get_stats() -> gpu_allocator_stats
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	gpu_allocator_stats stats{};
+	VkDeviceSize total_free = 0;
+	//free bytes that are not part of their block's largest free range
+	VkDeviceSize scattered_free = 0;
+	for (auto& pool : m_pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block.memory == VK_NULL_HANDLE)
+				continue;
+			stats.block_count++;
+			stats.allocation_count += block.allocation_count;
+			stats.bytes_reserved += block.size;
+			stats.bytes_used += block.bytes_used;
+			VkDeviceSize block_free = 0;
+			VkDeviceSize largest_free = 0;
+			for (size_t k = 0; k < block.free_lists.size(); k++)
+			{
+				VkDeviceSize range = (VkDeviceSize)1 << (k + MIN_ORDER);
+				block_free += range * block.free_lists[k].size();
+				if (!block.free_lists[k].empty())
+					largest_free = range;
+			}
+			total_free += block_free;
+			scattered_free += block_free - largest_free;
+		}
+	}
+	stats.fragmentation = total_free > 0 ?
+		(float)((double)scattered_free / (double)total_free) : 0.0f;
+	return stats;
+}
+
+auto dazai_engine::gpu_allocator::find_memory_type(uint32_t type_bits,
+	VkMemoryPropertyFlags mem_props) -> uint32_t
+{
+	for (uint32_t i = 0; i < m_mem_props.memoryTypeCount; i++)
+	{
+		if (type_bits & (1 << i) &&
+			(m_mem_props.memoryTypes[i].propertyFlags & mem_props) == mem_props)
+			return i;
+	}
+	return UINT32_MAX;
+}
+
+auto dazai_engine::gpu_allocator::find_pool(uint32_t memory_type, bool linear) -> uint32_t
+{
+	for (size_t p = 0; p < m_pools.size(); p++)
+	{
+		if (m_pools[p].memory_type == memory_type && m_pools[p].linear == linear)
+			return (uint32_t)p;
+	}
+	memory_pool pool{};
+	pool.memory_type = memory_type;
+	pool.linear = linear;
+	m_pools.push_back(pool);
+	return (uint32_t)m_pools.size() - 1;
+}
+
+auto dazai_engine::gpu_allocator::create_block(memory_pool& pool, VkDeviceSize size, bool dedicated) -> int32_t
+{
+	uint32_t block_count = 0;
+	for (auto& p : m_pools)
+		for (auto& b : p.blocks)
+			block_count += b.memory != VK_NULL_HANDLE ? 1 : 0;
+	if (block_count >= m_max_allocation_count)
+	{
+		LOG_ERROR("maxMemoryAllocationCount reached:", m_max_allocation_count);
+		return -1;
+	}
+
+	memory_block block{};
+	block.size = size;
+	block.dedicated = dedicated;
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = pool.memory_type;
+	VkResult result = vkAllocateMemory(m_device, &alloc_info, 0, &block.memory);
+	if (result != VK_SUCCESS)
+	{
+		LOG_ERROR("GPU memory block allocation failed:", result, "size:", size);
+		return -1;
+	}
+	//host visible blocks stay mapped for their whole lifetime,
+	//a VkDeviceMemory can only be mapped once
+	if (m_mem_props.memoryTypes[pool.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		VKCHECK(vkMapMemory(m_device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped));
+	}
+	if (!dedicated)
+	{
+		block.free_lists.resize(m_block_order - MIN_ORDER + 1);
+		block.free_lists.back().insert(0);
+	}
+
+	for (size_t b = 0; b < pool.blocks.size(); b++)
+	{
+		if (pool.blocks[b].memory == VK_NULL_HANDLE)
+		{
+			pool.blocks[b] = std::move(block);
+			return (int32_t)b;
+		}
+	}
+	pool.blocks.push_back(std::move(block));
+	return (int32_t)pool.blocks.size() - 1;
+}
+
+auto dazai_engine::gpu_allocator::buddy_alloc(memory_block& block, uint32_t order) -> VkDeviceSize
+{
+	//smallest free range that fits
+	uint32_t k = order;
+	while (k <= m_block_order && block.free_lists[k - MIN_ORDER].empty())
+		k++;
+	if (k > m_block_order)
+		return UINT64_MAX;
+	auto& list = block.free_lists[k - MIN_ORDER];
+	VkDeviceSize offset = *list.begin();
+	list.erase(list.begin());
+	//split down, the upper halves go back on the free lists
+	while (k > order)
+	{
+		k--;
+		block.free_lists[k - MIN_ORDER].insert(offset + ((VkDeviceSize)1 << k));
+	}
+	return offset;
+}
+
+auto dazai_engine::gpu_allocator::buddy_free(memory_block& block, VkDeviceSize offset, uint32_t order) -> void
+{
+	//merge with the buddy for as long as it is free too
+	while (order < m_block_order)
+	{
+		VkDeviceSize buddy = offset ^ ((VkDeviceSize)1 << order);
+		auto& list = block.free_lists[order - MIN_ORDER];
+		auto it = list.find(buddy);
+		if (it == list.end())
+			break;
+		list.erase(it);
+		offset = offset < buddy ? offset : buddy;
+		order++;
+	}
+	block.free_lists[order - MIN_ORDER].insert(offset);
+}
+
+auto dazai_engine::gpu_allocator::order_of(VkDeviceSize size) -> uint32_t
+{
+	uint32_t order = MIN_ORDER;
+	while (((VkDeviceSize)1 << order) < size)
+		order++;
+	return order;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "defines.h"
+
+namespace dazai_engine
+{
+	//a sub range of a VkDeviceMemory block
+	struct gpu_allocation
+	{
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkDeviceSize offset{ 0 };
+		//size asked for, the reserved range is rounded up to a power of two
+		VkDeviceSize size{ 0 };
+		//mapped pointer at offset, only for host visible memory
+		void* data{ nullptr };
+		uint32_t pool{ UINT32_MAX };
+		uint32_t block{ UINT32_MAX };
+		uint32_t order{ 0 };
+	};
+
+	struct gpu_allocator_stats
+	{
+		uint32_t block_count;
+		uint32_t allocation_count;
+		//sum of all VkDeviceMemory blocks
+		VkDeviceSize bytes_reserved;
+		//sum of requested sizes
+		VkDeviceSize bytes_used;
+		//share of free bytes outside the largest free range of their block,
+		//0 when every block's free space is one range
+		float fragmentation;
+	};
+
+	//sub allocates buffers and images from large per memory type blocks so
+	//we stay far below maxMemoryAllocationCount. every block is a buddy
+	//allocator: ranges are powers of two aligned to their own size, which
+	//covers any alignment up to the range size. linear (buffer) and optimal
+	//(image) resources use separate blocks so bufferImageGranularity can
+	//never be violated between neighbours
+	class gpu_allocator
+	{
+	public:
+		auto init(VkDevice device, VkPhysicalDevice physical_device,
+			VkDeviceSize block_size = MB(64)) -> void;
+		auto destroy() -> void;
+		//linear = buffers and linear images, false = optimal tiling images.
+		//returns an allocation with memory == VK_NULL_HANDLE on failure
+		auto allocate(VkMemoryRequirements mem_reqs, VkMemoryPropertyFlags mem_props,
+			bool linear) -> gpu_allocation;
+		auto free(gpu_allocation* allocation) -> void;
+		auto get_stats() -> gpu_allocator_stats;
+
+	private:
+		//smallest range handed out is 1 << MIN_ORDER bytes
+		static constexpr uint32_t MIN_ORDER = 8;
+
+		struct memory_block
+		{
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			VkDeviceSize size{ 0 };
+			void* mapped{ nullptr };
+			//whole block for one oversized resource, freed with it
+			bool dedicated{ false };
+			uint32_t allocation_count{ 0 };
+			VkDeviceSize bytes_used{ 0 };
+			//free offsets per order, index = order - MIN_ORDER
+			std::vector<std::set<VkDeviceSize>> free_lists;
+		};
+
+		struct memory_pool
+		{
+			uint32_t memory_type;
+			bool linear;
+			std::vector<memory_block> blocks;
+		};
+
+		auto find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags mem_props) -> uint32_t;
+		auto find_pool(uint32_t memory_type, bool linear) -> uint32_t;
+		auto create_block(memory_pool& pool, VkDeviceSize size, bool dedicated) -> int32_t;
+		auto buddy_alloc(memory_block& block, uint32_t order) -> VkDeviceSize;
+		auto buddy_free(memory_block& block, VkDeviceSize offset, uint32_t order) -> void;
+		auto order_of(VkDeviceSize size) -> uint32_t;
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkPhysicalDeviceMemoryProperties m_mem_props{};
+		uint32_t m_max_allocation_count{ 0 };
+		VkDeviceSize m_block_size{ 0 };
+		uint32_t m_block_order{ 0 };
+		std::vector<memory_pool> m_pools;
+		//allocate/free may be called from any thread
+		std::mutex m_mutex;
+	};
+}
@@ -0,0 +1,216 @@
+#include "logger.h"
+
+dazai_engine::logger::logger(const std::string& log_file_name, bool async) :
+    logFile(log_file_name), m_async(async)
+{
+    if (!m_async)
+        return;
+    m_slots = std::make_unique<log_slot[]>(RING_CAPACITY);
+    for (uint64_t i = 0; i < RING_CAPACITY; i++)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_writer = std::thread(&logger::writer_loop, this);
+}
+
+dazai_engine::logger::~logger()
+{
+    if (!m_async)
+        return;
+    //the writer drains whatever is left before it exits
+    m_stop.store(true, std::memory_order_release);
+    wake_writer();
+    m_writer.join();
+}
+
+auto dazai_engine::logger::open_binary(const std::string& log_file_name) -> bool
+{
+    flush();
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    logFile.close();
+    logFile.open(log_file_name, std::ios::binary | std::ios::trunc);
+    if (!logFile)
+        return false;
+    logFile.write(binary_log::MAGIC, sizeof(binary_log::MAGIC));
+    m_binary.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+auto dazai_engine::logger::register_site(log_site& site) -> uint32_t
+{
+    uint32_t id = m_next_site_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32_t expected = 0;
+    //another thread may register the same site at the same time, its id wins
+    if (!site.id.compare_exchange_strong(expected, id, std::memory_order_acq_rel))
+        return expected;
+    std::string record;
+    uint16_t file_length = (uint16_t)std::char_traits<char>::length(site.file);
+    record.push_back((char)binary_log::site_record);
+    put(record, id);
+    put(record, (uint8_t)site.level);
+    put(record, (uint32_t)site.line);
+    put(record, file_length);
+    record.append(site.file, file_length);
+    submit(std::move(record), true);
+    return id;
+}
+
+auto dazai_engine::logger::flush() -> void
+{
+    if (!m_async)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        logFile.flush();
+        std::cout.flush();
+        return;
+    }
+    uint64_t target = m_head.load(std::memory_order_acquire);
+    uint64_t tail = m_tail.load(std::memory_order_acquire);
+    while (tail < target)
+    {
+        m_tail.wait(tail, std::memory_order_acquire);
+        tail = m_tail.load(std::memory_order_acquire);
+    }
+}
+
+auto dazai_engine::logger::dropped_count() const -> uint64_t
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+auto dazai_engine::logger::submit(std::string&& text, bool must_deliver) -> void
+{
+    if (!m_async)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        write(text);
+        logFile.flush();
+        std::cout.flush();
+        return;
+    }
+    uint64_t position = m_head.load(std::memory_order_relaxed);
+    log_slot* slot;
+    for (;;)
+    {
+        slot = &m_slots[position & (RING_CAPACITY - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)sequence - (int64_t)position;
+        if (diff == 0)
+        {
+            //slot is free for this lap, try to claim it
+            if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            //writer hasn't freed it yet, the ring is full
+            if (must_deliver)
+            {
+                std::this_thread::yield();
+                position = m_head.load(std::memory_order_relaxed);
+                continue;
+            }
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            //another producer took it first
+            position = m_head.load(std::memory_order_relaxed);
+        }
+    }
+    slot->text = std::move(text);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    //pairs with the fence in writer_loop, either the writer's last look at
+    //the ring sees this record or this sees it parked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writer_parked.load(std::memory_order_relaxed))
+        wake_writer();
+}
+
+auto dazai_engine::logger::wake_writer() -> void
+{
+    m_wake_signal.fetch_add(1, std::memory_order_release);
+    m_wake_signal.notify_one();
+}
+
+auto dazai_engine::logger::has_work(uint64_t tail, uint64_t reported_dropped) const -> bool
+{
+    const log_slot& slot = m_slots[tail & (RING_CAPACITY - 1)];
+    return slot.sequence.load(std::memory_order_acquire) == tail + 1 ||
+        m_dropped.load(std::memory_order_relaxed) != reported_dropped ||
+        m_stop.load(std::memory_order_acquire);
+}
+
+auto dazai_engine::logger::write(const std::string& text) -> void
+{
+    //binary records are only for the decoder, nothing goes to the console
+    if (m_binary.load(std::memory_order_relaxed))
+    {
+        logFile.write(text.data(), text.size());
+        return;
+    }
+    logFile << text;
+    std::cout << text << "\n";
+}
+
+auto dazai_engine::logger::writer_loop() -> void
+{
+    uint64_t reported_dropped = 0;
+    for (;;)
+    {
+        //read stop first so records pushed before it are still drained
+        bool stop = m_stop.load(std::memory_order_acquire);
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint32_t records = 0;
+        std::unique_lock<std::mutex> lock(m_write_mutex);
+        for (;;)
+        {
+            log_slot& slot = m_slots[tail & (RING_CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+                break;
+            write(slot.text);
+            slot.text.clear();
+            slot.sequence.store(tail + RING_CAPACITY, std::memory_order_release);
+            tail++;
+            records++;
+        }
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped)
+        {
+            if (m_binary.load(std::memory_order_relaxed))
+            {
+                std::string record(1, (char)binary_log::drop_record);
+                put(record, dropped - reported_dropped);
+                write(record);
+            }
+            else
+            {
+                logFile << "[WARNING] logger dropped " << dropped - reported_dropped << " records\n";
+                std::cout << "[WARNING] logger dropped " << dropped - reported_dropped << " records\n\n";
+            }
+            reported_dropped = dropped;
+            records++;
+        }
+        //one flush per batch instead of one per record
+        if (records > 0)
+        {
+            logFile.flush();
+            std::cout.flush();
+            m_tail.store(tail, std::memory_order_release);
+            m_tail.notify_all();
+        }
+        lock.unlock();
+        if (records == 0)
+        {
+            if (stop)
+                return;
+            //park until a producer pushes into the empty ring. the signal is
+            //read before the last look so a wake in between isn't lost
+            m_writer_parked.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32_t signal = m_wake_signal.load(std::memory_order_acquire);
+            if (!has_work(tail, reported_dropped))
+                m_wake_signal.wait(signal, std::memory_order_acquire);
+            m_writer_parked.store(false, std::memory_order_relaxed);
+        }
+    }
+}
@@ -1,22 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vulkan/vulkan.h>
+#include "binary_log.h"
+
+//levels below LOG_MIN_LEVEL compile to nothing, arguments included.
+//release builds keep warnings and up unless the build sets it
+//output a command line flag asks for (timings, profiles, checks) is
+//printed to stdout instead, it must not depend on this
+#define LOG_LEVEL_INFO 0
+#define LOG_LEVEL_WARNING 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_VALIDATION 3
+#define LOG_LEVEL_OFF 4
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_WARNING
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
 
 namespace dazai_engine
 {
 
-    enum class LogLevel { info, warning, error, validation };
+    enum class LogLevel
+    {
+        info = LOG_LEVEL_INFO,
+        warning = LOG_LEVEL_WARNING,
+        error = LOG_LEVEL_ERROR,
+        validation = LOG_LEVEL_VALIDATION
+    };
+
+    //one per LOG_* call site, a static local of the macro. the id is
+    //handed out the first time the site logs in binary mode
+    struct log_site
+    {
+        LogLevel level;
+        const char* file;
+        int line;
+        std::atomic<uint32_t> id{ 0 };
+    };
+
     class logger
     {
     public:
-        logger(const std::string& log_file_name = "logs.txt") : logFile(log_file_name) {}
+        //async = records are formatted by the caller and written by a
+        //background thread, the caller never waits on disk or console I/O
+        logger(const std::string& log_file_name = "logs.txt", bool async = true);
+        ~logger();
+
+        //runtime filter on top of LOG_MIN_LEVEL, the macros check it before
+        //any argument is evaluated or formatted
+        auto enabled(LogLevel level) const -> bool
+        {
+            return (int)level >= m_min_level.load(std::memory_order_relaxed);
+        }
+        auto set_level(LogLevel level) -> void
+        {
+            m_min_level.store((int)level, std::memory_order_relaxed);
+        }
+
+        //switches to the binary format (see binary_log.h) in a new file,
+        //call it before other threads start logging
+        auto open_binary(const std::string& log_file_name) -> bool;
 
         template<typename... Args>
-        auto log(LogLevel level, const char* file, int line, Args&&... args) -> void
+        auto log(log_site& site, Args&&... args) -> void
         {
+            if (m_binary.load(std::memory_order_relaxed))
+            {
+                //site id + raw argument bytes, no formatting at all
+                std::string record;
+                record.reserve(64);
+                record.push_back((char)binary_log::log_record);
+                put(record, site_id(site));
+                put(record, (uint8_t)sizeof...(Args));
+                (encode_arg(record, std::forward<Args>(args)), ...);
+                submit(std::move(record));
+                return;
+            }
             std::string levelStr;
-            switch (level)
+            switch (site.level)
             {
             case LogLevel::info:
                 levelStr = "INFO";
@@ -32,29 +105,137 @@ namespace dazai_engine
                 break;
             }
 
-            logHelper(std::forward<Args>(args)...);
-            logFile << "[" << levelStr << "] " << file << ":" << line << std::endl;
-            std::cout << "[" << levelStr << "] " << file << ":" << line << std::endl << std::endl;
-
+            std::ostringstream record;
+            logHelper(record, std::forward<Args>(args)...);
+            record << "[" << levelStr << "] " << site.file << ":" << site.line << "\n";
+            submit(record.str());
         }
 
+        //blocks until every record pushed so far has been written
+        auto flush() -> void;
+        //records lost because the ring was full
+        auto dropped_count() const -> uint64_t;
 
     private:
+        //power of two, a full ring drops new records instead of blocking
+        static constexpr uint64_t RING_CAPACITY = 4096;
+
+        struct log_slot
+        {
+            //== position + 1 once the record at position is ready to read,
+            //== position + capacity once the writer freed it for the next lap
+            std::atomic<uint64_t> sequence{ 0 };
+            std::string text;
+        };
+
+        //must_deliver waits for space instead of dropping, for site records
+        auto submit(std::string&& text, bool must_deliver = false) -> void;
+        auto write(const std::string& text) -> void;
+        auto register_site(log_site& site) -> uint32_t;
+
+        auto site_id(log_site& site) -> uint32_t
+        {
+            uint32_t id = site.id.load(std::memory_order_acquire);
+            return id != 0 ? id : register_site(site);
+        }
+
+        template<typename T>
+        static auto put(std::string& record, T value) -> void
+        {
+            record.append((const char*)&value, sizeof(T));
+        }
+
+        static auto put_string(std::string& record, const char* text, size_t length) -> void
+        {
+            record.push_back((char)binary_log::arg_string);
+            put(record, (uint32_t)length);
+            record.append(text, length);
+        }
+
+        template<typename T>
+        static auto encode_arg(std::string& record, T&& arg) -> void
+        {
+            using value_type = std::decay_t<T>;
+            if constexpr (std::is_same_v<value_type, const char*> || std::is_same_v<value_type, char*>)
+            {
+                put_string(record, arg, std::char_traits<char>::length(arg));
+            }
+            else if constexpr (std::is_same_v<value_type, std::string>)
+            {
+                put_string(record, arg.data(), arg.size());
+            }
+            else if constexpr (std::is_same_v<value_type, char>)
+            {
+                put_string(record, &arg, 1);
+            }
+            else if constexpr (std::is_same_v<value_type, bool> || std::is_enum_v<value_type> ||
+                (std::is_integral_v<value_type> && std::is_signed_v<value_type>))
+            {
+                record.push_back((char)binary_log::arg_int);
+                put(record, (int64_t)arg);
+            }
+            else if constexpr (std::is_integral_v<value_type>)
+            {
+                record.push_back((char)binary_log::arg_uint);
+                put(record, (uint64_t)arg);
+            }
+            else if constexpr (std::is_floating_point_v<value_type>)
+            {
+                record.push_back((char)binary_log::arg_double);
+                put(record, (double)arg);
+            }
+            else if constexpr (std::is_pointer_v<value_type>)
+            {
+                record.push_back((char)binary_log::arg_pointer);
+                put(record, (uint64_t)(uintptr_t)arg);
+            }
+            else
+            {
+                //anything else only knows operator<<, send its text
+                std::ostringstream text;
+                text << arg;
+                std::string str = text.str();
+                put_string(record, str.data(), str.size());
+            }
+        }
+        auto writer_loop() -> void;
+        //something for the writer to do, a record, a drop or stop
+        auto has_work(uint64_t tail, uint64_t reported_dropped) const -> bool;
+        auto wake_writer() -> void;
+
         std::ofstream logFile;
+        bool m_async;
+        std::atomic<bool> m_binary{ false };
+        std::atomic<uint32_t> m_next_site_id{ 0 };
+        std::atomic<int> m_min_level{ LOG_MIN_LEVEL };
+        //held around every write to the file, sync mode writes from the
+        //calling thread one record at a time
+        std::mutex m_write_mutex;
+
+        //multi producer single consumer ring, producers claim a position
+        //with a CAS on the head, only the writer thread moves the tail
+        std::unique_ptr<log_slot[]> m_slots;
+        std::atomic<uint64_t> m_head{ 0 };
+        std::atomic<uint64_t> m_tail{ 0 };
+        std::atomic<uint64_t> m_dropped{ 0 };
+        std::atomic<bool> m_stop{ false };
+        //the writer sleeps on m_wake_signal once the ring is empty, producers
+        //only bump and notify it while m_writer_parked is set
+        std::atomic<bool> m_writer_parked{ false };
+        std::atomic<uint32_t> m_wake_signal{ 0 };
+        std::thread m_writer;
 
         template<typename T>
-        auto logHelper(T&& arg) ->void
+        auto logHelper(std::ostringstream& record, T&& arg) ->void
         {
-            logFile << arg;
-            std::cout << arg;
+            record << arg;
         }
 
         template<typename T, typename... Args>
-        auto logHelper(T&& arg, Args&&... args)->void
+        auto logHelper(std::ostringstream& record, T&& arg, Args&&... args)->void
         {
-            logFile << arg << " ";
-            std::cout << arg << " ";
-            logHelper(std::forward<Args>(args)...);
+            record << arg << " ";
+            logHelper(record, std::forward<Args>(args)...);
         }
     };
 
@@ -62,10 +243,36 @@ namespace dazai_engine
 
 }
 extern dazai_engine::logger g_logger;
-#define LOG_INFO(...)    g_logger.log(dazai_engine::LogLevel::info,    __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_WARNING(...) g_logger.log(dazai_engine::LogLevel::warning, __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_ERROR(...)   g_logger.log(dazai_engine::LogLevel::error,   __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_VK_VALIDATION(...)   g_logger.log(dazai_engine::LogLevel::validation,"",0,__VA_ARGS__)
+#define LOG_AT_LEVEL(level, file, line, ...)\
+do\
+{\
+    if (g_logger.enabled(level))\
+    {\
+        static dazai_engine::log_site site{ level, file, line };\
+        g_logger.log(site, __VA_ARGS__);\
+    }\
+} while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...)    LOG_AT_LEVEL(dazai_engine::LogLevel::info,    __FILE__, __LINE__, __VA_ARGS__)
+#else
+#define LOG_INFO(...)    ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) LOG_AT_LEVEL(dazai_engine::LogLevel::warning, __FILE__, __LINE__, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...)   LOG_AT_LEVEL(dazai_engine::LogLevel::error,   __FILE__, __LINE__, __VA_ARGS__)
+#else
+#define LOG_ERROR(...)   ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_VALIDATION
+#define LOG_VK_VALIDATION(...)   LOG_AT_LEVEL(dazai_engine::LogLevel::validation,"",0,__VA_ARGS__)
+#else
+#define LOG_VK_VALIDATION(...)   ((void)0)
+#endif
 
 #define VKCHECK(result)\
 if(result!=0)\
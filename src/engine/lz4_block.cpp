@@ -0,0 +1,183 @@
+#include "lz4_block.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	//matches are at least this long
+	constexpr size_t MIN_MATCH = 4;
+	//the last 5 bytes are always literals
+	constexpr size_t LAST_LITERALS = 5;
+	//the last match starts at least 12 bytes before the end
+	constexpr size_t MATCH_FIND_LIMIT = 12;
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr uint32_t HASH_BITS = 16;
+
+	auto read32(const uint8_t* p) -> uint32_t
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	auto hash4(uint32_t sequence) -> uint32_t
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	//bounds checked output cursor
+	struct writer
+	{
+		uint8_t* dst;
+		size_t capacity;
+		size_t size;
+
+		auto put(uint8_t byte) -> bool
+		{
+			if (size >= capacity)
+				return false;
+			dst[size++] = byte;
+			return true;
+		}
+
+		auto put(const uint8_t* bytes, size_t count) -> bool
+		{
+			if (capacity - size < count)
+				return false;
+			if (count == 0)
+				return true;
+			memcpy(dst + size, bytes, count);
+			size += count;
+			return true;
+		}
+
+		//length above the token's 15 as a run of 255s and a remainder
+		auto put_length(size_t length) -> bool
+		{
+			for (; length >= 255; length -= 255)
+				if (!put(255))
+					return false;
+			return put((uint8_t)length);
+		}
+
+		//match_length 0 = last sequence, literals only
+		auto put_sequence(const uint8_t* literals, size_t literal_length,
+			size_t offset, size_t match_length) -> bool
+		{
+			size_t match_code = match_length > 0 ? match_length - MIN_MATCH : 0;
+			uint8_t token = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4 |
+				(match_code < 15 ? match_code : 15));
+			if (!put(token))
+				return false;
+			if (literal_length >= 15 && !put_length(literal_length - 15))
+				return false;
+			if (!put(literals, literal_length))
+				return false;
+			if (match_length == 0)
+				return true;
+			if (!put((uint8_t)(offset & 0xff)) || !put((uint8_t)(offset >> 8)))
+				return false;
+			return match_code < 15 || put_length(match_code - 15);
+		}
+	};
+
+	//reads a length continued past the token's 15, false if it runs off the end
+	auto read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) -> bool
+	{
+		for (;;)
+		{
+			if (ip >= end)
+				return false;
+			uint8_t byte = *ip++;
+			length += byte;
+			if (byte != 255)
+				return true;
+		}
+	}
+}
+
+auto dazai_engine::lz4_block::compress_bound(size_t size) -> size_t
+{
+	return size + size / 255 + 16;
+}
+
+auto dazai_engine::lz4_block::compress(const uint8_t* src, size_t size,
+	uint8_t* dst, size_t capacity) -> size_t
+{
+	writer out{ dst, capacity, 0 };
+	size_t anchor = 0;
+	if (size > MATCH_FIND_LIMIT)
+	{
+		//last position seen for each hashed 4 byte sequence, +1 so 0 is empty
+		std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+		size_t match_limit = size - LAST_LITERALS;
+		size_t i = 0;
+		while (i + MATCH_FIND_LIMIT < size)
+		{
+			uint32_t sequence = read32(src + i);
+			uint32_t& entry = table[hash4(sequence)];
+			size_t candidate = entry;
+			entry = (uint32_t)(i + 1);
+			if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET ||
+				read32(src + candidate - 1) != sequence)
+			{
+				i++;
+				continue;
+			}
+			candidate--;
+			size_t length = MIN_MATCH;
+			while (i + length < match_limit && src[candidate + length] == src[i + length])
+				length++;
+			if (!out.put_sequence(src + anchor, i - anchor, i - candidate, length))
+				return 0;
+			i += length;
+			anchor = i;
+		}
+	}
+	if (!out.put_sequence(src + anchor, size - anchor, 0, 0))
+		return 0;
+	return out.size;
+}
+
+auto dazai_engine::lz4_block::decompress(const uint8_t* src, size_t size,
+	uint8_t* dst, size_t dst_size) -> bool
+{
+	const uint8_t* ip = src;
+	const uint8_t* ip_end = src + size;
+	uint8_t* op = dst;
+	uint8_t* op_end = dst + dst_size;
+	while (ip < ip_end)
+	{
+		uint8_t token = *ip++;
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !read_length(ip, ip_end, literal_length))
+			return false;
+		if ((size_t)(ip_end - ip) < literal_length || (size_t)(op_end - op) < literal_length)
+			return false;
+		if (literal_length > 0)
+			memcpy(op, ip, literal_length);
+		ip += literal_length;
+		op += literal_length;
+		//the last sequence ends after its literals
+		if (ip == ip_end)
+			break;
+		if (ip_end - ip < 2)
+			return false;
+		size_t offset = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return false;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !read_length(ip, ip_end, match_length))
+			return false;
+		match_length += MIN_MATCH;
+		if ((size_t)(op_end - op) < match_length)
+			return false;
+		//byte by byte, the match may overlap what it is writing
+		const uint8_t* match = op - offset;
+		for (size_t k = 0; k < match_length; k++)
+			op[k] = match[k];
+		op += match_length;
+	}
+	return op == op_end;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//lz4 block format (no frame) compressor and decompressor, output of
+//compress is readable by any lz4 implementation and the other way round.
+//compress is a greedy single probe matcher, good enough for offline packing
+namespace dazai_engine
+{
+	namespace lz4_block
+	{
+		//worst case compressed size of size input bytes
+		auto compress_bound(size_t size) -> size_t;
+		//returns the compressed size, 0 if it doesn't fit in capacity
+		auto compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) -> size_t;
+		//false on malformed input or if the output isn't exactly dst_size bytes
+		auto decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size) -> bool;
+	}
+}
@@ -0,0 +1,117 @@
+#include "mapped_file.h"
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+dazai_engine::mapped_file::~mapped_file()
+{
+	close();
+}
+
+dazai_engine::mapped_file::mapped_file(mapped_file&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+auto dazai_engine::mapped_file::operator=(mapped_file&& other) noexcept -> mapped_file&
+{
+	if (this != &other)
+	{
+		close();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+#ifdef _WIN32
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+auto dazai_engine::mapped_file::open(const char* path) -> bool
+{
+	close();
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_data = (const uint8_t*)view;
+	m_size = (uint64_t)size.QuadPart;
+	return true;
+}
+
+auto dazai_engine::mapped_file::close() -> void
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = nullptr;
+}
+#else
+auto dazai_engine::mapped_file::open(const char* path) -> bool
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info{};
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps its own reference to the file
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	//assets are read front to back once
+	madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+	m_data = (const uint8_t*)view;
+	m_size = (uint64_t)info.st_size;
+	return true;
+}
+
+auto dazai_engine::mapped_file::close() -> void
+{
+	if (m_data)
+		munmap((void*)m_data, (size_t)m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+#endif
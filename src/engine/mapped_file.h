@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+namespace dazai_engine
+{
+	//read only memory mapping of a whole file. the span from bytes() is only
+	//valid while the mapped_file is alive, it is unmapped on destruction.
+	//move only so exactly one owner unmaps it
+	class mapped_file
+	{
+	public:
+		mapped_file() = default;
+		~mapped_file();
+		mapped_file(const mapped_file&) = delete;
+		auto operator=(const mapped_file&) -> mapped_file& = delete;
+		mapped_file(mapped_file&& other) noexcept;
+		auto operator=(mapped_file&& other) noexcept -> mapped_file&;
+
+		//path is used as is, false if the file can't be opened or is empty
+		auto open(const char* path) -> bool;
+		auto close() -> void;
+		auto is_open() const -> bool { return m_data != nullptr; }
+		auto bytes() const -> std::span<const uint8_t> { return { m_data, m_size }; }
+		auto data() const -> const uint8_t* { return m_data; }
+		auto size() const -> uint64_t { return m_size; }
+
+	private:
+		const uint8_t* m_data{ nullptr };
+		uint64_t m_size{ 0 };
+#ifdef _WIN32
+		void* m_file{ nullptr };
+		void* m_mapping{ nullptr };
+#endif
+	};
+}
@@ -0,0 +1,201 @@
+#include "profiler.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+std::mutex dazai_engine::profiler::s_tracks_mutex;
+std::vector<std::unique_ptr<dazai_engine::profile_track>> dazai_engine::profiler::s_tracks;
+
+namespace
+{
+	thread_local dazai_engine::profile_track* t_track = nullptr;
+}
+
+auto dazai_engine::profiler::now_ns() -> uint64_t
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+auto dazai_engine::profiler::create_track(const std::string& name) -> profile_track*
+{
+	std::lock_guard<std::mutex> lock(s_tracks_mutex);
+	auto track = std::make_unique<profile_track>();
+	track->name = name;
+	track->id = (uint32_t)s_tracks.size() + 1;
+	track->events = std::make_unique<profile_event_slot[]>(profile_track::CAPACITY);
+	s_tracks.push_back(std::move(track));
+	return s_tracks.back().get();
+}
+
+auto dazai_engine::profiler::thread_track() -> profile_track*
+{
+	if (t_track == nullptr)
+		t_track = create_track("thread");
+	return t_track;
+}
+
+auto dazai_engine::profiler::set_thread_name(const char* name) -> void
+{
+	profile_track* track = thread_track();
+	std::lock_guard<std::mutex> lock(track->name_mutex);
+	track->name = name;
+}
+
+auto dazai_engine::profiler::named_track(const char* name) -> profile_track*
+{
+	{
+		std::lock_guard<std::mutex> lock(s_tracks_mutex);
+		for (auto& track : s_tracks)
+			if (track_name(*track) == name)
+				return track.get();
+	}
+	return create_track(name);
+}
+
+auto dazai_engine::profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns) -> void
+{
+	record(thread_track(), name, start_ns, end_ns);
+}
+
+auto dazai_engine::profiler::record(profile_track* track, const char* name,
+	uint64_t start_ns, uint64_t end_ns) -> void
+{
+	//only this thread stores head, so a relaxed load sees its own last store
+	uint64_t head = track->head.load(std::memory_order_relaxed);
+	profile_event_slot& slot = track->events[head % profile_track::CAPACITY];
+	//keeps the last head store ahead of the overwrite, a reader that sees
+	//any of the new values also sees that this slot was lapped
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start_ns.store(start_ns, std::memory_order_relaxed);
+	slot.end_ns.store(end_ns, std::memory_order_relaxed);
+	track->head.store(head + 1, std::memory_order_release);
+}
+
+auto dazai_engine::profiler::read_events(profile_track& track) -> std::vector<profile_event>
+{
+	uint64_t head = track.head.load(std::memory_order_acquire);
+	uint64_t count = std::min<uint64_t>(head, profile_track::CAPACITY);
+	std::vector<profile_event> events;
+	events.reserve(count);
+	for (uint64_t e = head - count; e < head; e++)
+	{
+		const profile_event_slot& slot = track.events[e % profile_track::CAPACITY];
+		events.push_back({ slot.name.load(std::memory_order_relaxed),
+			slot.start_ns.load(std::memory_order_relaxed),
+			slot.end_ns.load(std::memory_order_relaxed) });
+	}
+	//the writer kept going while we copied. the event it is writing now,
+	//at new_head, overwrites new_head - CAPACITY, so anything at or below
+	//that may be torn
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t new_head = track.head.load(std::memory_order_relaxed);
+	uint64_t first = head - count;
+	if (new_head >= profile_track::CAPACITY && new_head - profile_track::CAPACITY >= first)
+	{
+		uint64_t lapped = std::min<uint64_t>(new_head - profile_track::CAPACITY - first + 1, count);
+		events.erase(events.begin(), events.begin() + (ptrdiff_t)lapped);
+	}
+	return events;
+}
+
+auto dazai_engine::profiler::track_name(profile_track& track) -> std::string
+{
+	std::lock_guard<std::mutex> lock(track.name_mutex);
+	return track.name;
+}
+
+auto dazai_engine::profiler::zone_stats(double window_seconds) -> std::vector<profile_zone_stats>
+{
+	uint64_t window_start = now_ns() - (uint64_t)(window_seconds * 1e9);
+	//durations per (track name, zone), so the pool's workers add up to one
+	//"worker" row per zone
+	struct zone_samples
+	{
+		const char* name;
+		std::string track;
+		std::vector<uint64_t> durations;
+	};
+	std::vector<zone_samples> zones;
+	std::unordered_map<std::string, std::unordered_map<const char*, size_t>> lookup;
+	std::lock_guard<std::mutex> tracks_lock(s_tracks_mutex);
+	for (auto& track : s_tracks)
+	{
+		std::string name = track_name(*track);
+		for (const profile_event& event : read_events(*track))
+		{
+			if (event.end_ns < window_start)
+				continue;
+			auto& track_zones = lookup[name];
+			auto it = track_zones.find(event.name);
+			if (it == track_zones.end())
+			{
+				it = track_zones.emplace(event.name, zones.size()).first;
+				zones.push_back({ event.name, name, {} });
+			}
+			zones[it->second].durations.push_back(event.end_ns - event.start_ns);
+		}
+	}
+	std::vector<profile_zone_stats> stats;
+	stats.reserve(zones.size());
+	for (auto& zone : zones)
+	{
+		std::vector<uint64_t>& d = zone.durations;
+		std::sort(d.begin(), d.end());
+		uint64_t total = 0;
+		for (uint64_t ns : d)
+			total += ns;
+		size_t p99_index = (d.size() * 99 + 99) / 100 - 1;
+		profile_zone_stats s{};
+		s.name = zone.name;
+		s.track = std::move(zone.track);
+		s.count = (uint32_t)d.size();
+		s.min_ms = d.front() / 1e6;
+		s.avg_ms = total / 1e6 / d.size();
+		s.p99_ms = d[std::min(p99_index, d.size() - 1)] / 1e6;
+		s.max_ms = d.back() / 1e6;
+		stats.push_back(s);
+	}
+	return stats;
+}
+
+auto dazai_engine::profiler::print_summary(double window_seconds) -> void
+{
+	for (const profile_zone_stats& s : zone_stats(window_seconds))
+	{
+		printf("Profile %s %s count: %u min ms: %.3f avg ms: %.3f p99 ms: %.3f max ms: %.3f\n",
+			s.track.c_str(), s.name, s.count, s.min_ms, s.avg_ms, s.p99_ms, s.max_ms);
+	}
+	fflush(stdout);
+}
+
+auto dazai_engine::profiler::write_chrome_trace(const char* path) -> bool
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		LOG_ERROR("Failed to open trace file:", path);
+		return false;
+	}
+	//complete ("X") events in microseconds, one tid per track
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	std::lock_guard<std::mutex> tracks_lock(s_tracks_mutex);
+	for (auto& track : s_tracks)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", track->id, track_name(*track).c_str());
+		first = false;
+		for (const profile_event& event : read_events(*track))
+		{
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, track->id, event.start_ns / 1e3, (event.end_ns - event.start_ns) / 1e3);
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
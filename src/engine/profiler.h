@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//PROFILE_ZONE compiles to nothing when the build sets PROFILER_ENABLED=0
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+namespace dazai_engine
+{
+	struct profile_event
+	{
+		//string literal, zones are grouped by pointer
+		const char* name;
+		uint64_t start_ns;
+		uint64_t end_ns;
+	};
+
+	//ring slot, atomics so readers may copy it while the owner overwrites it
+	struct profile_event_slot
+	{
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start_ns{ 0 };
+		std::atomic<uint64_t> end_ns{ 0 };
+	};
+
+	//rolling summary of one zone over the requested window
+	struct profile_zone_stats
+	{
+		const char* name;
+		//copied, the track may be renamed after the stats are taken
+		std::string track;
+		uint32_t count;
+		double min_ms;
+		double avg_ms;
+		double p99_ms;
+		double max_ms;
+	};
+
+	//one timeline in the trace, every thread gets its own the first time it
+	//records a zone, other sources (gpu timestamps) get named ones.
+	//a fixed ring with a single writer, the oldest events are overwritten.
+	//recording takes no lock, readers copy the ring and drop whatever the
+	//writer lapped while they were copying
+	struct profile_track
+	{
+		static constexpr uint32_t CAPACITY = 16384;
+
+		//guards name only
+		std::mutex name_mutex;
+		std::string name;
+		uint32_t id;
+		std::unique_ptr<profile_event_slot[]> events;
+		//events recorded so far, only the writer stores it
+		std::atomic<uint64_t> head{ 0 };
+	};
+
+	class profiler
+	{
+	public:
+		//steady clock in ns, the timebase of every event
+		static auto now_ns() -> uint64_t;
+		//name of the calling thread's track in traces and summaries
+		static auto set_thread_name(const char* name) -> void;
+		//track for events that don't come from a cpu thread
+		static auto named_track(const char* name) -> profile_track*;
+		//on the calling thread's track
+		static auto record(const char* name, uint64_t start_ns, uint64_t end_ns) -> void;
+		//a named track must only be recorded to from one thread at a time
+		static auto record(profile_track* track, const char* name, uint64_t start_ns, uint64_t end_ns) -> void;
+
+		//per zone min/avg/p99/max over events that ended in the last window_seconds
+		static auto zone_stats(double window_seconds = 1.0) -> std::vector<profile_zone_stats>;
+		//zone_stats printed to stdout, it was asked for so no log level hides it
+		static auto print_summary(double window_seconds = 1.0) -> void;
+		//everything still in the rings, load it in chrome://tracing or perfetto
+		static auto write_chrome_trace(const char* path) -> bool;
+
+	private:
+		static auto thread_track() -> profile_track*;
+		//events still in the ring, oldest first, without stopping the writer
+		static auto read_events(profile_track& track) -> std::vector<profile_event>;
+		static auto track_name(profile_track& track) -> std::string;
+		static auto create_track(const std::string& name) -> profile_track*;
+
+		static std::mutex s_tracks_mutex;
+		//tracks outlive their threads so finished threads still show up in traces
+		static std::vector<std::unique_ptr<profile_track>> s_tracks;
+	};
+
+	//records the time between construction and destruction as one zone
+	class profile_zone
+	{
+	public:
+		profile_zone(const char* name) : m_name(name), m_start(profiler::now_ns()) {}
+		~profile_zone()
+		{
+			profiler::record(m_name, m_start, profiler::now_ns());
+		}
+		profile_zone(const profile_zone&) = delete;
+		auto operator=(const profile_zone&) -> profile_zone& = delete;
+	private:
+		const char* m_name;
+		uint64_t m_start;
+	};
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name) dazai_engine::profile_zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
@@ -1,22 +1,30 @@
 #include "renderer.h"
 #include "glfw_window.h"
-#define VK_USE_PLATFORM_WIN32_KHR
-#define GLFW_INCLUDE_VULKAN
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
-#include <vulkan/vulkan_win32.h>
 #include <vector>
+#include <cstring>
 #include "resources.h"
 #include "logger.h"
+#include "profiler.h"
 
-dazai_engine::renderer::renderer(glfw_window* window):
-	m_window(window)
+dazai_engine::renderer::renderer(glfw_window* window, renderer_config config):
+	m_window(window),
+	m_config(config),
+	m_frames_in_flight(config.frames_in_flight > 0 ? config.frames_in_flight : 1),
+	m_width(config.headless ? config.headless_width : window->width),
+	m_height(config.headless ? config.headless_height : window->height),
+	m_gpu_simulation(config.gpu_simulation)
 {
 	init();
 }
 
 dazai_engine::renderer::~renderer()
 {
+	//joins the io thread, it may still be submitting on the transfer queue
+	m_streamer.shutdown();
+	//frames in flight may still be executing
+	vkDeviceWaitIdle(m_context.device);
+	save_pipeline_cache();
+	m_context.allocator.destroy();
 	vkDestroySurfaceKHR(m_context.instance, m_context.surface, nullptr);
 	vkDestroyInstance(m_context.instance, nullptr);
 	vkDestroyDevice(m_context.device, nullptr);
@@ -41,18 +49,35 @@ auto dazai_engine::renderer::init() -> bool
 	VkInstanceCreateInfo instance_info{};
 	instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instance_info.pApplicationInfo = &app_info;
-	//glfw extensions
-	uint32_t glfw_extension_count = 0;
-	const char** glfw_extensions;
-	glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-	std::vector<const char*> extensions(glfw_extensions,
-		glfw_extensions + glfw_extension_count);
+	//glfw extensions, headless has no surface so it needs none of them
+	std::vector<const char*> extensions;
+	if (!m_config.headless)
+	{
+		uint32_t glfw_extension_count = 0;
+		const char** glfw_extensions;
+		glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+	}
 	//add other extensions
 	extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	instance_info.ppEnabledExtensionNames = extensions.data();
 	instance_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	//bench and ci machines usually don't ship the validation layer,
+	//instance creation fails if we ask for one that isn't there
+	uint32_t layer_count = 0;
+	vkEnumerateInstanceLayerProperties(&layer_count, 0);
+	std::vector<VkLayerProperties> available_layers(layer_count);
+	vkEnumerateInstanceLayerProperties(&layer_count, available_layers.data());
+	bool has_validation = false;
+	for (const auto& layer : available_layers)
+	{
+		if (strcmp(layer.layerName, layers[0]) == 0)
+			has_validation = true;
+	}
+	if (!has_validation)
+		LOG_WARNING("Validation layer not available, running without it");
 	instance_info.ppEnabledLayerNames = layers;
-	instance_info.enabledLayerCount = ARRAYSIZE(layers);
+	instance_info.enabledLayerCount = has_validation ? ARRAYSIZE(layers) : 0;
 	//CREATE INSTANCE
 	VKCHECK(vkCreateInstance(&instance_info, nullptr, &m_context.instance));
 	//ENABLE DEBUG MESSENGER
@@ -83,12 +108,13 @@ auto dazai_engine::renderer::init() -> bool
 	{
 		LOG_ERROR("DEBUG MESSENGER FUNCTION PTR NOT FOUND");
 	}
-	//crete vulkan surface
-	VkWin32SurfaceCreateInfoKHR surface_info{};
-	surface_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	surface_info.hwnd = glfwGetWin32Window(m_window->window);
-	surface_info.hinstance = GetModuleHandle(nullptr);
-	VKCHECK(vkCreateWin32SurfaceKHR(m_context.instance, &surface_info, 0, &m_context.surface));
+	//crete vulkan surface, glfw picks win32/xlib/xcb/wayland for us and
+	//already asked for the matching instance extensions above
+	if (!m_config.headless)
+	{
+		VKCHECK(glfwCreateWindowSurface(m_context.instance, m_window->window,
+			0, &m_context.surface));
+	}
 	//select physical device
 	uint32_t device_count = 0;
 	vkEnumeratePhysicalDevices(m_context.instance, &device_count, nullptr);
@@ -100,6 +126,7 @@ auto dazai_engine::renderer::init() -> bool
 		LOG_WARNING("You have more than one supported physical devices, set accordingly");
 	//I only have 1 device so setting directly
 	m_context.physical_device = devices[0];
+	vkGetPhysicalDeviceProperties(m_context.physical_device, &m_context.device_properties);
 	//check queue families in selected gpu
 	uint32_t queue_family_count = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(m_context.physical_device, &queue_family_count, nullptr);
@@ -108,11 +135,21 @@ auto dazai_engine::renderer::init() -> bool
 	int i = 0;
 	for (const auto& queue_family: queue_families)
 	{
-		if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) // check if queue family has graphic queue
+		if (!m_context.graphic_family_queue_index.has_value() &&
+			queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) // check if queue family has graphic queue
+		{
 			m_context.graphic_family_queue_index = i;
-
-		if (m_context.graphic_family_queue_index.has_value()) // if value was assigned break
-			break;
+			m_context.timestamp_valid_bits = queue_family.timestampValidBits;
+		}
+		//transfer only family, usually a dma engine that copies while the
+		//graphics queue renders
+		if (m_config.dedicated_transfer_queue &&
+			!m_context.transfer_family_queue_index.has_value() &&
+			queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+			!(queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			m_context.transfer_family_queue_index = i;
+		}
 
 		i++;
 	}
@@ -121,16 +158,32 @@ auto dazai_engine::renderer::init() -> bool
 		LOG_ERROR("Graphic queue family failed");
 		return false;
 	}
+	LOG_INFO("Dedicated transfer queue:", m_context.transfer_family_queue_index.has_value());
 	//CREATE LOGICAL DEVICE
 	//first we need to configure queue family we going to use in logical device
-	VkDeviceQueueCreateInfo queue_create_info{};
-	queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queue_create_info.queueFamilyIndex = m_context.graphic_family_queue_index.value();
-	queue_create_info.queueCount = 1;
+	//graphics queue + the transfer queue if there is a family for it
+	VkDeviceQueueCreateInfo queue_create_infos[2]{};
 	float queue_priority = 1;
-	queue_create_info.pQueuePriorities = &queue_priority;
-	//configure physical device feature we will be using;
-	VkPhysicalDeviceFeatures device_features{}; // nothing for now
+	uint32_t queue_create_count = 0;
+	for (auto family : { m_context.graphic_family_queue_index, m_context.transfer_family_queue_index })
+	{
+		if (!family.has_value())
+			continue;
+		VkDeviceQueueCreateInfo& queue_create_info = queue_create_infos[queue_create_count++];
+		queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queue_create_info.queueFamilyIndex = family.value();
+		queue_create_info.queueCount = 1;
+		queue_create_info.pQueuePriorities = &queue_priority;
+	}
+	//configure physical device feature we will be using,
+	//only ones the device reports can be enabled
+	VkPhysicalDeviceFeatures supported_features{};
+	vkGetPhysicalDeviceFeatures(m_context.physical_device, &supported_features);
+	VkPhysicalDeviceFeatures device_features{};
+	//bc1/bc3/bc7 dds textures, most mobile gpus don't have it
+	device_features.textureCompressionBC = supported_features.textureCompressionBC;
+	m_context.texture_compression_bc = supported_features.textureCompressionBC == VK_TRUE;
+	LOG_INFO("BC texture compression:", m_context.texture_compression_bc);
 	//create extensions for logical device
 	const char* sc_extensions[] = 
 	{
@@ -139,82 +192,35 @@ auto dazai_engine::renderer::init() -> bool
 	//now create logical device
 	VkDeviceCreateInfo device_create_info{};
 	device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	device_create_info.pQueueCreateInfos = &queue_create_info;
-	device_create_info.queueCreateInfoCount = 1;
+	device_create_info.pQueueCreateInfos = queue_create_infos;
+	device_create_info.queueCreateInfoCount = queue_create_count;
 	device_create_info.pEnabledFeatures = &device_features;
 	device_create_info.ppEnabledExtensionNames = sc_extensions;
-	device_create_info.enabledExtensionCount = ARRAYSIZE(sc_extensions);
+	device_create_info.enabledExtensionCount = m_config.headless ? 0 : ARRAYSIZE(sc_extensions);
 	VKCHECK(vkCreateDevice(m_context.physical_device,
 		&device_create_info,0,&m_context.device));
+	//all buffers and images are sub allocated from here
+	m_context.allocator.init(m_context.device, m_context.physical_device);
 	//Retrieving queue handles
 	vkGetDeviceQueue(m_context.device,m_context.graphic_family_queue_index.value(),
 		0,&m_context.graphics_queue);
-	//CREATE SWAP CHAIN
-	//get surface capabilities for pre swapchain config data
-	VkSurfaceCapabilitiesKHR surface_capabilities{};
-	VKCHECK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_context.physical_device,
-		m_context.surface, &surface_capabilities));
-	uint32_t surface_img_count = surface_capabilities.minImageCount + 1;
-	surface_img_count =
-		surface_img_count > surface_capabilities.maxImageCount ?
-		surface_img_count - 1 : surface_img_count;
-	//get surface format
-	uint32_t format_count = 0;
-	VKCHECK( vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physical_device, m_context.surface,
-		&format_count, 0));
-	std::vector<VkSurfaceFormatKHR> formats(format_count);
-	vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physical_device, m_context.surface,
-		&format_count, formats.data());
-	for (auto format: formats)
-	{
-		if (format.format == VK_FORMAT_B8G8R8A8_SRGB)
-		{
-			m_context.surface_format = format;
-			break;
-		}		
-	}
-	VkSwapchainCreateInfoKHR sc_info{};
-	sc_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	sc_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	sc_info.surface = m_context.surface;
-	sc_info.preTransform = surface_capabilities.currentTransform;
-	sc_info.imageExtent = surface_capabilities.currentExtent;
-	sc_info.minImageCount = surface_img_count;
-	sc_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	sc_info.imageArrayLayers = 1;
-	sc_info.imageFormat = m_context.surface_format.format;
-	VKCHECK(vkCreateSwapchainKHR(m_context.device, &sc_info, 0,
-		&m_context.swap_chain));
-	//GET SWAP CHAIN IMAGES
-	VKCHECK( vkGetSwapchainImagesKHR(m_context.device, m_context.swap_chain, 
-		&m_context.sc_image_count, 0));
-	//resize the images vector
-	m_context.sc_images.resize(m_context.sc_image_count);
-	//now assign swap chain images
-	VKCHECK(vkGetSwapchainImagesKHR(m_context.device, m_context.swap_chain,
-		&m_context.sc_image_count, m_context.sc_images.data()));
-	//SWAP CHAIN IMAGE VIEWS
-	VkImageViewCreateInfo iv_info{};
-	iv_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	iv_info.format = m_context.surface_format.format;
-	iv_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	iv_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	iv_info.subresourceRange.layerCount = 1;
-	iv_info.subresourceRange.levelCount = 1;
-	m_context.sc_image_views.resize(m_context.sc_image_count);
-	for (size_t i = 0; i < m_context.sc_image_count; i++)
-	{
-		iv_info.image = m_context.sc_images[i];
-		VKCHECK (vkCreateImageView(m_context.device, &iv_info,
-			0, &m_context.sc_image_views[i]));
-	}
+	if (m_context.transfer_family_queue_index.has_value())
+		vkGetDeviceQueue(m_context.device, m_context.transfer_family_queue_index.value(),
+			0, &m_context.transfer_queue);
+	//before any pipeline is created, they all go through it
+	create_pipeline_cache();
+	//render targets, swapchain images or offscreen images we own
+	if (m_config.headless ? !create_offscreen_targets() : !create_swapchain())
+		return false;
 
 	//RENDER PASS
 	VkRenderPassCreateInfo rp_info{};
 	VkAttachmentDescription attachment{};
 	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	//offscreen targets stay ready for a readback copy instead of present
+	attachment.finalLayout = m_config.headless ?
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
 	attachment.format = m_context.surface_format.format;
@@ -242,8 +248,8 @@ auto dazai_engine::renderer::init() -> bool
 	fb_info.renderPass = m_context.render_pass;
 	fb_info.layers = 1;
 	fb_info.attachmentCount = 1;
-	fb_info.width = m_window->width;
-	fb_info.height = m_window->height;
+	fb_info.width = m_width;
+	fb_info.height = m_height;
 	m_context.frame_buffers.resize(m_context.sc_image_count);
 	for (size_t i = 0; i < m_context.sc_image_count; i++)
 	{
@@ -284,24 +290,27 @@ auto dazai_engine::renderer::init() -> bool
 	//vertex shader info
 	uint32_t v_size_bytes;
 	//TODO: abstract shaders and refactor
-	char* v_code = resources::
-		read_raw_file("shaders/default.vert.spv", &v_size_bytes);
+	//spir-v is read straight from the mapping or pack, both keep pCode word aligned
+	asset_data v_code;
+	if (!resources::load_asset("shaders/default.vert.spv", &v_code))
+		return false;
+	v_size_bytes = (uint32_t)v_code.bytes.size();
 	VkShaderModuleCreateInfo vs_info{};
 	vs_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	vs_info.pCode = (uint32_t*)v_code;
+	vs_info.pCode = (const uint32_t*)v_code.bytes.data();
 	vs_info.codeSize = v_size_bytes;
 	VKCHECK( vkCreateShaderModule(m_context.device,&vs_info,0,&v_module));
-	delete v_code;
 	//fragment shader info
 	uint32_t f_size_bytes;
-	char* f_code = resources::
-		read_raw_file("shaders/default.frag.spv", &f_size_bytes);
+	asset_data f_code;
+	if (!resources::load_asset("shaders/default.frag.spv", &f_code))
+		return false;
+	f_size_bytes = (uint32_t)f_code.bytes.size();
 	VkShaderModuleCreateInfo fs_info{};
 	fs_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	fs_info.pCode = (uint32_t*)f_code;
+	fs_info.pCode = (const uint32_t*)f_code.bytes.data();
 	fs_info.codeSize = f_size_bytes;
 	VKCHECK( vkCreateShaderModule(m_context.device,&fs_info,0,&f_module));
-	delete f_code;
 	//vertex stage
 	VkPipelineShaderStageCreateInfo v_stage{};
 	v_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -323,14 +332,14 @@ auto dazai_engine::renderer::init() -> bool
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = (float)m_window->width;
-	viewport.height = (float)m_window->height;
+	viewport.width = (float)m_width;
+	viewport.height = (float)m_height;
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	//scissor
 	VkRect2D scissor{};
 	scissor.offset = { 0,0 };
-	scissor.extent = { m_window->width,m_window->height };
+	scissor.extent = { m_width,m_height };
 	//dynamic state for viewports 
 	VkDynamicState dynamic_states[]{
 		VK_DYNAMIC_STATE_VIEWPORT,
@@ -370,7 +379,7 @@ auto dazai_engine::renderer::init() -> bool
 		
 		VkDescriptorSetLayoutBinding bindings[] = {
 			layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,VK_SHADER_STAGE_VERTEX_BIT,1,0),
-			layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_VERTEX_BIT,1,1),
+			layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,VK_SHADER_STAGE_VERTEX_BIT,1,1),
 			layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT,1,2),
 		};
 		VkDescriptorSetLayoutCreateInfo layout_info{};
@@ -400,7 +409,7 @@ auto dazai_engine::renderer::init() -> bool
 	p_info.pRasterizationState = &rasterization_state;
 	p_info.pMultisampleState = &msa_info;
 	p_info.layout = m_context.pipeline_layout;
-	vkCreateGraphicsPipelines(m_context.device,0,
+	vkCreateGraphicsPipelines(m_context.device,m_context.pipeline_cache,
 		1,&p_info,0,&m_context.pipeline );
 	vkDestroyShaderModule(m_context.device, v_module, 0);
 	vkDestroyShaderModule(m_context.device, f_module, 0);
@@ -410,38 +419,100 @@ auto dazai_engine::renderer::init() -> bool
 	VkCommandPoolCreateInfo pool_info{};
 	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	pool_info.queueFamilyIndex = m_context.graphic_family_queue_index.value();
+	//static secondaries get re-recorded individually when their binds change
+	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	vkCreateCommandPool(m_context.device,&pool_info,0,
 		&m_context.command_pool);
-	//SEMAPHORES
-	VkSemaphoreCreateInfo semaphore_info{};
-	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	VKCHECK(vkCreateSemaphore(m_context.device,&semaphore_info,0,
-		&m_context.acquire_semaphore));
-	VKCHECK( vkCreateSemaphore(m_context.device,&semaphore_info,0,
-		&m_context.submit_semaphore));
-	//FENCES
-	VkFenceCreateInfo f_info = fence_info(VK_FENCE_CREATE_SIGNALED_BIT);
-	VKCHECK(vkCreateFence(m_context.device,&f_info,0,
-		&m_context.submit_queue_fence));
+	//FRAMES IN FLIGHT
+	//each frame gets its own semaphores, fence and command buffer so the cpu
+	//can record the next frame while the gpu still renders the previous one
+	m_context.frames.resize(m_frames_in_flight);
+	m_context.image_fences.assign(m_context.sc_image_count, VK_NULL_HANDLE);
+	for (auto& frame : m_context.frames)
+	{
+		//SEMAPHORES
+		VkSemaphoreCreateInfo semaphore_info{};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		VKCHECK(vkCreateSemaphore(m_context.device,&semaphore_info,0,
+			&frame.acquire_semaphore));
+		VKCHECK( vkCreateSemaphore(m_context.device,&semaphore_info,0,
+			&frame.submit_semaphore));
+		//FENCES, signaled so the first wait on every frame returns immediately
+		VkFenceCreateInfo f_info = fence_info(VK_FENCE_CREATE_SIGNALED_BIT);
+		VKCHECK(vkCreateFence(m_context.device,&f_info,0,
+			&frame.in_flight_fence));
+		//COMMAND POOL + BUFFER, allocated once and reset with the whole pool every frame
+		VkCommandPoolCreateInfo frame_pool_info{};
+		frame_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		frame_pool_info.queueFamilyIndex = m_context.graphic_family_queue_index.value();
+		frame_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		VKCHECK(vkCreateCommandPool(m_context.device,&frame_pool_info,0,
+			&frame.command_pool));
+		VkCommandBufferAllocateInfo frame_cmd_alloc = cmd_alloc_info(frame.command_pool);
+		VKCHECK(vkAllocateCommandBuffers(m_context.device,
+			&frame_cmd_alloc,&frame.cmd));
+		//static secondary lives in the long lived pool so pool resets keep it
+		if (m_config.prerecord_static_commands)
+		{
+			VkCommandBufferAllocateInfo static_cmd_alloc = cmd_alloc_info(m_context.command_pool);
+			static_cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			VKCHECK(vkAllocateCommandBuffers(m_context.device,
+				&static_cmd_alloc,&frame.static_cmd));
+		}
+		//TIMESTAMP QUERIES, one pool per frame so reading one never waits on another
+		frame.timestamp_pool = VK_NULL_HANDLE;
+		frame.timestamps_pending = false;
+		if (m_config.gpu_timestamps && m_context.timestamp_valid_bits > 0)
+		{
+			VkQueryPoolCreateInfo query_info{};
+			query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			query_info.queryCount = gpu_zone_count * 2;
+			VKCHECK(vkCreateQueryPool(m_context.device, &query_info, 0, &frame.timestamp_pool));
+		}
+	}
+	if (m_config.gpu_timestamps && m_context.timestamp_valid_bits > 0)
+		m_context.gpu_track = profiler::named_track("gpu");
 
 	//STAGING BUFFER
 	m_context.staging_buffer = alloc_buffer(
 		m_context.device,
-		m_context.physical_device,
 		MB(10),
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
 		);
 
-	// load image
+	//the staging buffer serves as per frame upload ring, the placeholder
+	//texture goes through frame 0's region, no frame is in flight yet
+	setup_staging_ring();
+	//placeholder image, the real textures are streamed in on the io thread
+	//and swapped in by update_streamed_textures
 	{
-		DDSFile* data = resources::load_dds_file("textures/water.dds");
-		uint32_t texture_size = data->header.Width * data->header.Height * 4;//4 = rgba
-		copy_to_buffer(&m_context.staging_buffer,&data->dataBegin,texture_size);
-		
-		//TODO:Abstract` the image loading
-		m_context.image = alloc_image(m_context.device,m_context.physical_device,
-			data->header.Width,data->header.Height,VK_FORMAT_R8G8B8A8_UNORM);
+		//one opaque texel, sprites draw as plain quads until the texture is in
+		uint8_t placeholder_pixels[] = { 255, 255, 255, 255 };
+		dds_texture texture{};
+		texture.width = 1;
+		texture.height = 1;
+		texture.mip_count = 1;
+		texture.mips[0] = { 0, sizeof(placeholder_pixels), 1, 1 };
+		texture.pixels = placeholder_pixels;
+		texture.pixel_bytes = sizeof(placeholder_pixels);
+		VkFormat texture_format = VK_FORMAT_R8G8B8A8_UNORM;
+		uint32_t texture_size = (uint32_t)texture.pixel_bytes;
+		frame_data& upload_frame = m_context.frames[0];
+		uint32_t texture_offset = staging_alloc(upload_frame, texture_size);
+		if (texture_offset == UINT32_MAX)
+		{
+			LOG_ERROR("Staging ring out of space for texture, bytes:", texture_size);
+			return false;
+		}
+		memcpy((char*)m_context.staging_buffer.data + texture_offset, texture.pixels, texture_size);
+
+		m_context.image = alloc_image(m_context.device,
+			texture.width,texture.height,texture_format,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,texture.mip_count);
+		m_context.image_format = texture_format;
+		m_context.image_mip_count = texture.mip_count;
 		VkCommandBuffer cmd;
 		VkCommandBufferAllocateInfo cmd_alloc = cmd_alloc_info(m_context.command_pool);
 		VKCHECK( vkAllocateCommandBuffers(m_context.device,
@@ -451,7 +522,7 @@ auto dazai_engine::renderer::init() -> bool
 
 		VkImageSubresourceRange range{};
 		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.levelCount = 1;
+		range.levelCount = texture.mip_count;
 		range.layerCount = 1;
 		//transition layout to transfer optimal
 		VkImageMemoryBarrier image_barrier{};
@@ -468,13 +539,19 @@ auto dazai_engine::renderer::init() -> bool
 		0, 0, 0, 0,
 			0, 1, &image_barrier);
 		
-		VkBufferImageCopy copy_region{};
-		copy_region.imageExtent = { data->header.Width, data->header.Height,1 };
-		copy_region.imageSubresource.layerCount = 1;
-		copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		//every mip in one copy, they sit back to back in staging like in the file
+		VkBufferImageCopy copy_regions[DDS_MAX_MIPS]{};
+		for (uint32_t m = 0; m < texture.mip_count; m++)
+		{
+			copy_regions[m].bufferOffset = texture_offset + texture.mips[m].offset;
+			copy_regions[m].imageExtent = { texture.mips[m].width, texture.mips[m].height,1 };
+			copy_regions[m].imageSubresource.mipLevel = m;
+			copy_regions[m].imageSubresource.layerCount = 1;
+			copy_regions[m].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		}
 		vkCmdCopyBufferToImage(cmd,m_context.staging_buffer.vk_buffer,
 			m_context.image.vk_image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,&copy_region);
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,texture.mip_count,copy_regions);
 
 		image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 		image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -495,18 +572,22 @@ auto dazai_engine::renderer::init() -> bool
 
 		VkSubmitInfo sub_info = submit_info(&cmd);
 		vkQueueSubmit(m_context.graphics_queue, 1, &sub_info, upload_fence);
+		//a single texel, waiting here costs nothing
 		VKCHECK( vkWaitForFences(m_context.device,1,&upload_fence,
 			true,UINT64_MAX));
+		vkDestroyFence(m_context.device, upload_fence, 0);
+		vkFreeCommandBuffers(m_context.device, m_context.command_pool, 1, &cmd);
+		upload_frame.staging_head = 0;
 	}
 	//image view
 	{
 		VkImageViewCreateInfo view_info{};
 		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		view_info.image = m_context.image.vk_image;
-		view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		view_info.format = m_context.image_format;
 		view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		view_info.subresourceRange.layerCount = 1;
-		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.levelCount = m_context.image_mip_count;
 		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
 
 		VKCHECK( vkCreateImageView(m_context.device, &view_info,
@@ -518,36 +599,57 @@ auto dazai_engine::renderer::init() -> bool
 		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		sampler_info.minFilter = VK_FILTER_NEAREST;
 		sampler_info.magFilter = VK_FILTER_NEAREST;
+		//sprites are drawn far smaller than the texture, blend between mips
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		sampler_info.minLod = 0.0f;
+		//the view limits the levels, streamed textures bring their own count
+		sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+		sampler_info.mipLodBias = 0.0f;
 
 		VKCHECK( vkCreateSampler(m_context.device, &sampler_info, 
 			0, &m_context.sampler));
 	}
 
-	//create transform storage buffer
+	//create transform storage buffer, frames write to separate slices
+	{
+		//on uma the host visible path is already in the memory the gpu reads,
+		//a staging copy would only add work
+		VkPhysicalDeviceType device_type = m_context.device_properties.deviceType;
+		bool uma = device_type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+			device_type == VK_PHYSICAL_DEVICE_TYPE_CPU;
+		m_context.transform_device_local = m_config.device_local_transforms && !uma;
+		LOG_INFO("Device local transforms:", m_context.transform_device_local);
+		m_context.transform_slice_size = (uint32_t)transform_slice_size(DEFAULT_ENTITY_CAPACITY);
+		m_context.transform_storage_buffer =
+			alloc_transform_buffer(m_context.transform_slice_size * m_frames_in_flight);
+		for (uint32_t f = 0; f < m_frames_in_flight; f++)
+			m_context.frames[f].transform_offset = f * m_context.transform_slice_size;
+	}
+
+	//create indirect draw buffer
 	{
-		m_context.transform_storage_buffer = alloc_buffer(m_context.device,
-			m_context.physical_device,
-			sizeof(transform) * MAX_ENTITIES,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		m_context.draw_indirect_buffer = alloc_buffer(m_context.device,
+			sizeof(VkDrawIndexedIndirectCommand) * m_frames_in_flight,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		for (uint32_t f = 0; f < m_frames_in_flight; f++)
+			m_context.frames[f].indirect_offset = f * sizeof(VkDrawIndexedIndirectCommand);
 	}
 
 	//create ubo
 	{
 		m_context.global_ubo = alloc_buffer(m_context.device,
-			m_context.physical_device,
 			sizeof(global_data),
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 		//copy data to buffer
-		global_data data = { m_window->width, m_window->height };
+		global_data data = { (int)m_width, (int)m_height };
 		copy_to_buffer(&m_context.global_ubo, &data,sizeof(global_data));
 	}
 	//create ibo
 	m_context.ibo = alloc_buffer
 	(
 		m_context.device,
-		m_context.physical_device,
 		sizeof(uint32_t) * 6,
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
@@ -558,142 +660,474 @@ auto dazai_engine::renderer::init() -> bool
 		copy_to_buffer(&m_context.ibo,&indices,sizeof(uint32_t) * 6);
 	}
 
-	//descriptor pool
+	//descriptor pool, a set per frame so a streamed texture can be bound
+	//to each frame once its fence signalled, without waiting on the others
 	{
 		VkDescriptorPoolSize pool_sizes[] = {
-			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
-			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
-			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_frames_in_flight},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, m_frames_in_flight},
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_frames_in_flight}
 		};
 
 
 		VkDescriptorPoolCreateInfo pool_info{};
 		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		pool_info.maxSets = 1;
+		pool_info.maxSets = m_frames_in_flight;
 		pool_info.poolSizeCount = ARRAYSIZE(pool_sizes);
 		pool_info.pPoolSizes = pool_sizes;
 		vkCreateDescriptorPool(m_context.device, &pool_info,
 			0, &m_context.descriptor_pool);
 	}
-	//create descriptor set
+	//create descriptor sets
+	for (auto& frame : m_context.frames)
 	{
 		VkDescriptorSetAllocateInfo alloc_info{};
 		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		alloc_info.pSetLayouts = &m_context.set_layout;
 		alloc_info.descriptorSetCount = 1;
 		alloc_info.descriptorPool = m_context.descriptor_pool;
-		vkAllocateDescriptorSets(m_context.device,&alloc_info,&m_context.descriptor_set);
+		vkAllocateDescriptorSets(m_context.device,&alloc_info,&frame.descriptor_set);
+
+		descriptor_info desc_infos[] = 
+		{
+			descriptor_info(m_context.global_ubo.vk_buffer),
+			descriptor_info(m_context.transform_storage_buffer.vk_buffer,0,m_context.transform_slice_size),
+			descriptor_info(m_context.sampler,m_context.image.view)
+		};
+
+		VkWriteDescriptorSet writes[] = {
+			write_set(frame.descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 
+			&desc_infos[0],0,1),
+			write_set(frame.descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+			&desc_infos[1],1,1),
+			write_set(frame.descriptor_set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			&desc_infos[2],2,1)
+		};
+		//update descriptor set
+		vkUpdateDescriptorSets(m_context.device,ARRAYSIZE(writes),
+			writes, 0, 0);
+		frame.texture_generation = 0;
+	}
+	m_context.texture_generation = 0;
+	if (m_config.prerecord_static_commands)
+		record_static_commands();
+	if (m_gpu_simulation && !create_gpu_solver())
+	{
+		LOG_WARNING("GPU particle solver unavailable, simulating on the cpu");
+		m_gpu_simulation = false;
+	}
+	//TEXTURE STREAMING, loads and uploads off the render thread
+	m_streamer.init(m_context.device, m_context.physical_device, &m_context.allocator,
+		m_context.graphic_family_queue_index.value(),
+		m_context.transfer_family_queue_index.value_or(m_context.graphic_family_queue_index.value()),
+		m_context.transfer_queue, m_context.texture_compression_bc);
+	m_streamer.request("textures/water.dds");
+	return true;
+}
+
+auto dazai_engine::renderer::create_swapchain() -> bool
+{
+	//CREATE SWAP CHAIN
+	//get surface capabilities for pre swapchain config data
+	VkSurfaceCapabilitiesKHR surface_capabilities{};
+	VKCHECK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_context.physical_device,
+		m_context.surface, &surface_capabilities));
+	uint32_t surface_img_count = surface_capabilities.minImageCount + 1;
+	surface_img_count =
+		surface_img_count > surface_capabilities.maxImageCount ?
+		surface_img_count - 1 : surface_img_count;
+	//get surface format
+	uint32_t format_count = 0;
+	VKCHECK( vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physical_device, m_context.surface,
+		&format_count, 0));
+	std::vector<VkSurfaceFormatKHR> formats(format_count);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(m_context.physical_device, m_context.surface,
+		&format_count, formats.data());
+	for (auto format: formats)
+	{
+		if (format.format == VK_FORMAT_B8G8R8A8_SRGB)
+		{
+			m_context.surface_format = format;
+			break;
+		}		
+	}
+	VkSwapchainCreateInfoKHR sc_info{};
+	sc_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	sc_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	sc_info.surface = m_context.surface;
+	sc_info.preTransform = surface_capabilities.currentTransform;
+	sc_info.imageExtent = surface_capabilities.currentExtent;
+	sc_info.minImageCount = surface_img_count;
+	sc_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	sc_info.imageArrayLayers = 1;
+	sc_info.imageFormat = m_context.surface_format.format;
+	VKCHECK(vkCreateSwapchainKHR(m_context.device, &sc_info, 0,
+		&m_context.swap_chain));
+	//GET SWAP CHAIN IMAGES
+	VKCHECK( vkGetSwapchainImagesKHR(m_context.device, m_context.swap_chain, 
+		&m_context.sc_image_count, 0));
+	//resize the images vector
+	m_context.sc_images.resize(m_context.sc_image_count);
+	//now assign swap chain images
+	VKCHECK(vkGetSwapchainImagesKHR(m_context.device, m_context.swap_chain,
+		&m_context.sc_image_count, m_context.sc_images.data()));
+	//SWAP CHAIN IMAGE VIEWS
+	VkImageViewCreateInfo iv_info{};
+	iv_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	iv_info.format = m_context.surface_format.format;
+	iv_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	iv_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	iv_info.subresourceRange.layerCount = 1;
+	iv_info.subresourceRange.levelCount = 1;
+	m_context.sc_image_views.resize(m_context.sc_image_count);
+	for (size_t i = 0; i < m_context.sc_image_count; i++)
+	{
+		iv_info.image = m_context.sc_images[i];
+		VKCHECK (vkCreateImageView(m_context.device, &iv_info,
+			0, &m_context.sc_image_views[i]));
 	}
+	return true;
+}
 
-	descriptor_info desc_infos[] = 
+auto dazai_engine::renderer::create_pipeline_cache() -> void
+{
+	VkPipelineCacheCreateInfo cache_info{};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	//vkCreatePipelineCache copies the data, the mapping can go right after
+	mapped_file cache_file;
+	if (m_config.pipeline_cache_path && cache_file.open(m_config.pipeline_cache_path))
 	{
-		descriptor_info(m_context.global_ubo.vk_buffer),
-		descriptor_info(m_context.transform_storage_buffer.vk_buffer),
-		descriptor_info(m_context.sampler,m_context.image.view)
-	};
+		//drivers are meant to reject foreign data themselves, not all of them do
+		VkPipelineCacheHeaderVersionOne header{};
+		const VkPhysicalDeviceProperties& props = m_context.device_properties;
+		if (cache_file.size() >= sizeof(header))
+			memcpy(&header, cache_file.data(), sizeof(header));
+		if (cache_file.size() < sizeof(header) ||
+			header.headerSize < sizeof(header) ||
+			header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			header.vendorID != props.vendorID ||
+			header.deviceID != props.deviceID ||
+			memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			LOG_INFO("Pipeline cache is from another gpu or driver, starting empty:",
+				m_config.pipeline_cache_path);
+		}
+		else
+		{
+			cache_info.initialDataSize = cache_file.size();
+			cache_info.pInitialData = cache_file.data();
+		}
+	}
+	VkResult result = vkCreatePipelineCache(m_context.device, &cache_info, 0, &m_context.pipeline_cache);
+	if (result != VK_SUCCESS && cache_info.initialDataSize > 0)
+	{
+		LOG_WARNING("Pipeline cache rejected by the driver, starting empty:", result);
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = nullptr;
+		result = vkCreatePipelineCache(m_context.device, &cache_info, 0, &m_context.pipeline_cache);
+	}
+	if (result != VK_SUCCESS)
+	{
+		//pipelines still work without one, they just compile from scratch
+		LOG_WARNING("Pipeline cache unavailable:", result);
+		m_context.pipeline_cache = VK_NULL_HANDLE;
+		return;
+	}
+	LOG_INFO("Pipeline cache loaded, bytes:", cache_info.initialDataSize);
+}
 
-	VkWriteDescriptorSet writes[] = {
-		write_set(m_context.descriptor_set, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 
-		&desc_infos[0],0,1),
-		write_set(m_context.descriptor_set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-		&desc_infos[1],1,1),
-		write_set(m_context.descriptor_set, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-		&desc_infos[2],2,1)
-	};
-	//update descriptor set
-	vkUpdateDescriptorSets(m_context.device,ARRAYSIZE(writes),
-		writes, 0, 0);
+auto dazai_engine::renderer::save_pipeline_cache() -> void
+{
+	if (m_context.pipeline_cache == VK_NULL_HANDLE)
+		return;
+	if (m_config.pipeline_cache_path)
+	{
+		size_t size = 0;
+		VKCHECK(vkGetPipelineCacheData(m_context.device, m_context.pipeline_cache, &size, nullptr));
+		std::vector<char> data(size);
+		//VK_INCOMPLETE if it grew in between, the prefix is still a valid cache
+		VkResult result = vkGetPipelineCacheData(m_context.device, m_context.pipeline_cache,
+			&size, data.data());
+		if ((result == VK_SUCCESS || result == VK_INCOMPLETE) && size > 0 &&
+			resources::write_file(m_config.pipeline_cache_path, data.data(), size))
+			LOG_INFO("Pipeline cache saved, bytes:", size);
+	}
+	vkDestroyPipelineCache(m_context.device, m_context.pipeline_cache, 0);
+	m_context.pipeline_cache = VK_NULL_HANDLE;
+}
+
+auto dazai_engine::renderer::create_offscreen_targets() -> bool
+{
+	//one image per frame in flight, a frame only reuses its own image
+	//after its fence signalled so frames never write the same target
+	m_context.surface = VK_NULL_HANDLE;
+	m_context.swap_chain = VK_NULL_HANDLE;
+	m_context.surface_format.format = VK_FORMAT_R8G8B8A8_SRGB;
+	m_context.surface_format.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	m_context.sc_image_count = m_frames_in_flight;
+	m_context.offscreen_images.resize(m_context.sc_image_count);
+	m_context.sc_images.resize(m_context.sc_image_count);
+	m_context.sc_image_views.resize(m_context.sc_image_count);
+	for (size_t i = 0; i < m_context.sc_image_count; i++)
+	{
+		image& target = m_context.offscreen_images[i];
+		target = alloc_image(m_context.device,
+			m_width, m_height, m_context.surface_format.format,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		if (target.allocation.memory == VK_NULL_HANDLE)
+		{
+			LOG_ERROR("Offscreen target allocation failed");
+			return false;
+		}
+		VkImageViewCreateInfo iv_info{};
+		iv_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		iv_info.image = target.vk_image;
+		iv_info.format = m_context.surface_format.format;
+		iv_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		iv_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		iv_info.subresourceRange.layerCount = 1;
+		iv_info.subresourceRange.levelCount = 1;
+		VKCHECK(vkCreateImageView(m_context.device, &iv_info,
+			0, &target.view));
+		m_context.sc_images[i] = target.vk_image;
+		m_context.sc_image_views[i] = target.view;
+	}
+	//tightly packed rgba8 copy of one target for capture_frame
+	m_context.readback_buffer = alloc_buffer(m_context.device,
+		m_width * m_height * 4,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	LOG_INFO("Headless render targets:", m_context.sc_image_count, "size:", m_width, m_height);
 	return true;
 }
 
 auto dazai_engine::renderer::render(simulation_state* state) -> bool
 {
-	//copy transforms from simulation
+	frame_data& frame = m_context.frames[m_context.frame_index];
+	//WAIT UNTIL THE GPU IS DONE WITH THIS FRAME'S RESOURCES
+	//only blocks when the cpu is a full m_frames_in_flight frames ahead
+	{
+		PROFILE_ZONE("fence wait");
+		VKCHECK(vkWaitForFences(m_context.device,1,&frame.in_flight_fence, VK_TRUE, UINT64_MAX));
+	}
+	//this frame's queries from m_frames_in_flight frames ago are done, no stall
+	if (frame.timestamps_pending)
+		read_timestamps(frame);
+	//nothing reads this frame's staging region anymore
+	frame.staging_head = 0;
+	//pack transforms from simulation into this frame's slice, either directly
+	//into mapped memory or into the staging ring for a copy at the top of the frame
+	uint32_t transform_staging_offset = 0;
+	uint32_t transform_upload_size = 0;
+	//the gpu solver writes the slice itself, nothing to upload
+	uint32_t instance_count = m_gpu_simulation ?
+		m_context.gpu_solver.particle_count : state->entity_count;
 	{
-		copy_to_buffer(&m_context.transform_storage_buffer,
-			&state->entities,
-			sizeof(transform) * state->entity_count);
+		if (!reserve_transform_buffer(instance_count))
+			return false;
+		if (!m_gpu_simulation && m_context.transform_device_local)
+		{
+			uint32_t size = sizeof(transform) * state->entity_count;
+			if (!reserve_staging_ring(size))
+				return false;
+			transform_staging_offset = staging_alloc(frame, size);
+			if (transform_staging_offset == UINT32_MAX)
+			{
+				LOG_ERROR("Staging ring out of space");
+				return false;
+			}
+			upload_transforms(&m_context.staging_buffer, transform_staging_offset, state);
+			transform_upload_size = size;
+		}
+		else if (!m_gpu_simulation)
+		{
+			upload_transforms(&m_context.transform_storage_buffer, frame.transform_offset, state);
+		}
 	}
 
 
-	//ACQUIRE SWAPCHAIN IMAGE
-	uint32_t image_idx;
-	VKCHECK( vkAcquireNextImageKHR(m_context.device,m_context.swap_chain
-		,0,m_context.acquire_semaphore,0,&image_idx));
-	//allocate command buffer
-	VkCommandBuffer cmd;
-	VkCommandBufferAllocateInfo alloc_info = cmd_alloc_info(m_context.command_pool);
-	VKCHECK(vkAllocateCommandBuffers(m_context.device,&alloc_info, &cmd));
+	//ACQUIRE SWAPCHAIN IMAGE, headless frames own their offscreen target
+	uint32_t image_idx = m_context.frame_index;
+	if (!m_config.headless)
+	{
+		PROFILE_ZONE("acquire");
+		VKCHECK( vkAcquireNextImageKHR(m_context.device,m_context.swap_chain
+			,UINT64_MAX,frame.acquire_semaphore,0,&image_idx));
+		//an older frame may still be rendering to this image
+		if (m_context.image_fences[image_idx] != VK_NULL_HANDLE &&
+			m_context.image_fences[image_idx] != frame.in_flight_fence)
+		{
+			VKCHECK(vkWaitForFences(m_context.device,1,&m_context.image_fences[image_idx],
+				VK_TRUE, UINT64_MAX));
+		}
+		m_context.image_fences[image_idx] = frame.in_flight_fence;
+	}
+	//only headless targets can be read back
+	bool capture = m_config.headless && !m_capture_path.empty();
+	uint64_t record_start = profiler::now_ns();
+	//swap in finished textures, the frame's set and secondary are free to change
+	update_streamed_textures(frame, capture);
+	//the gpu is done with this frame, drop everything recorded from its pool at once
+	VKCHECK(vkResetCommandPool(m_context.device, frame.command_pool, 0));
+	VkCommandBuffer cmd = frame.cmd;
 	VkCommandBufferBeginInfo begin_info = cmd_begin_info();
 	VKCHECK( vkBeginCommandBuffer(cmd, &begin_info));
+	frame.timestamp_zones = 0;
+	if (frame.timestamp_pool != VK_NULL_HANDLE)
+		vkCmdResetQueryPool(cmd, frame.timestamp_pool, 0, gpu_zone_count * 2);
+	write_timestamp(cmd, frame, gpu_zone_frame, true);
+	//textures copied on the transfer queue change owner before their first use
+	for (auto& texture : m_context.pending_acquires)
+		m_streamer.record_acquire(cmd, texture);
+	m_context.pending_acquires.clear();
+	//GPU SOLVER, steps the particles and writes them into this frame's slice
+	if (m_gpu_simulation)
+	{
+		write_timestamp(cmd, frame, gpu_zone_solver, true);
+		record_gpu_steps(cmd, frame);
+		write_timestamp(cmd, frame, gpu_zone_solver, false);
+	}
+	//TRANSFORM UPLOAD, copy staged transforms into this frame's device local slice
+	if (transform_upload_size > 0)
+	{
+		write_timestamp(cmd, frame, gpu_zone_upload, true);
+		VkBufferCopy copy_region{};
+		copy_region.srcOffset = transform_staging_offset;
+		copy_region.dstOffset = frame.transform_offset;
+		copy_region.size = transform_upload_size;
+		vkCmdCopyBuffer(cmd, m_context.staging_buffer.vk_buffer,
+			m_context.transform_storage_buffer.vk_buffer, 1, &copy_region);
+		//make the copy visible to the vertex shader reading the slice
+		VkBufferMemoryBarrier buffer_barrier{};
+		buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		buffer_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.buffer = m_context.transform_storage_buffer.vk_buffer;
+		buffer_barrier.offset = frame.transform_offset;
+		buffer_barrier.size = transform_upload_size;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0, 0, 0, 1, &buffer_barrier, 0, 0);
+		write_timestamp(cmd, frame, gpu_zone_upload, false);
+	}
 	VkClearValue clear_value{};
 	clear_value.color = { 253.0 / 255.0, 234.0 / 255.0, 183.0 / 255.0, 1.0 };
 	//renderpass begin
 	VkRenderPassBeginInfo rp_begin_info{};
 	rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	rp_begin_info.renderPass = m_context.render_pass;
-	VkExtent2D screen_size = {m_window->width,m_window->height};
+	VkExtent2D screen_size = {m_width,m_height};
 	rp_begin_info.renderArea.extent = screen_size;
 	rp_begin_info.framebuffer = m_context.frame_buffers[image_idx];
 	rp_begin_info.pClearValues = &clear_value;
 	rp_begin_info.clearValueCount = 1;
-	vkCmdBeginRenderPass(cmd, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 	//RENDERING COMMANDS
+	write_timestamp(cmd, frame, gpu_zone_render_pass, true);
+	if (m_config.prerecord_static_commands)
 	{
-		VkRect2D scissor{};
-		scissor.extent = { m_window->width,m_window->height };
-		VkViewport viewport{};
-		viewport.width = m_window->width;
-		viewport.height = m_window->height;
-		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(cmd, 0, 1, &viewport);
-		vkCmdSetScissor(cmd,0,1,&scissor);
-
-		vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
-			m_context.pipeline_layout,
-			0,1, &m_context.descriptor_set 
-			,0,0);
-
-		vkCmdBindIndexBuffer(cmd,m_context.ibo.vk_buffer,
-			0,VK_INDEX_TYPE_UINT32);
-		vkCmdBindPipeline(cmd,
-			VK_PIPELINE_BIND_POINT_GRAPHICS, m_context.pipeline);
-		vkCmdDrawIndexed(cmd,6,state->entity_count,
-			0,0,0);
+		//only the instance count changes between frames
+		VkDrawIndexedIndirectCommand draw_args{};
+		draw_args.indexCount = 6;
+		draw_args.instanceCount = instance_count;
+		memcpy((char*)m_context.draw_indirect_buffer.data + frame.indirect_offset,
+			&draw_args, sizeof(draw_args));
+		vkCmdBeginRenderPass(cmd, &rp_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(cmd, 1, &frame.static_cmd);
+	}
+	else
+	{
+		vkCmdBeginRenderPass(cmd, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		record_draw(cmd, frame, instance_count, false);
 	}
 	vkCmdEndRenderPass(cmd);
+	write_timestamp(cmd, frame, gpu_zone_render_pass, false);
+	//READBACK, copy the finished target into the host visible readback buffer
+	if (capture)
+	{
+		VkImageMemoryBarrier image_barrier{};
+		image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		image_barrier.image = m_context.sc_images[image_idx];
+		image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		image_barrier.subresourceRange.levelCount = 1;
+		image_barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, 0, 0, 0, 1, &image_barrier);
+		VkBufferImageCopy copy_region{};
+		copy_region.imageExtent = { m_width, m_height, 1 };
+		copy_region.imageSubresource.layerCount = 1;
+		copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		vkCmdCopyImageToBuffer(cmd, m_context.sc_images[image_idx],
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			m_context.readback_buffer.vk_buffer, 1, &copy_region);
+		VkBufferMemoryBarrier buffer_barrier{};
+		buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		buffer_barrier.buffer = m_context.readback_buffer.vk_buffer;
+		buffer_barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			0, 0, 0, 1, &buffer_barrier, 0, 0);
+	}
+	write_timestamp(cmd, frame, gpu_zone_frame, false);
 	VKCHECK(vkEndCommandBuffer(cmd));
+	profiler::record("record commands", record_start, profiler::now_ns());
 	//RESET SUBMIT FENCE FIRST
-	VKCHECK(vkResetFences(m_context.device,1, &m_context.submit_queue_fence));
+	VKCHECK(vkResetFences(m_context.device,1, &frame.in_flight_fence));
 	//SUMBIT
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &cmd;
-	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = &m_context.acquire_semaphore;
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = &m_context.submit_semaphore;
+	//headless has nothing to acquire or present, the fence is all we need
+	submit_info.waitSemaphoreCount = m_config.headless ? 0 : 1;
+	submit_info.pWaitSemaphores = &frame.acquire_semaphore;
+	submit_info.signalSemaphoreCount = m_config.headless ? 0 : 1;
+	submit_info.pSignalSemaphores = &frame.submit_semaphore;
 	//assign wait stage mask for submit request
 	VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	submit_info.pWaitDstStageMask = &wait_stage;
-	vkQueueSubmit(m_context.graphics_queue,1,&submit_info, m_context.submit_queue_fence);
-	//wait for fence
-	VKCHECK(vkWaitForFences(m_context.device,1,&m_context.submit_queue_fence, VK_TRUE, UINT64_MAX));
-	//PRESENT
-	VkPresentInfoKHR present_info{};
-	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	present_info.pSwapchains = &m_context.swap_chain;
-	present_info.swapchainCount = 1;
-	present_info.pImageIndices = &image_idx;
-	present_info.pWaitSemaphores = &m_context.submit_semaphore;
-	present_info.waitSemaphoreCount = 1;
-	VKCHECK(vkQueuePresentKHR(m_context.graphics_queue, &present_info));
-
-	//FREE COMMAND BUFFER
-	vkFreeCommandBuffers(m_context.device,
-		m_context.command_pool, 1, &cmd);
+	frame.timestamp_submit_ns = profiler::now_ns();
+	frame.timestamps_pending = frame.timestamp_pool != VK_NULL_HANDLE;
+	{
+		PROFILE_ZONE("submit");
+		VKCHECK(vkQueueSubmit(m_context.graphics_queue,1,&submit_info, frame.in_flight_fence));
+	}
+	if (capture)
+	{
+		//captures are for debugging and regression images, stalling here is fine
+		VKCHECK(vkWaitForFences(m_context.device,1,&frame.in_flight_fence, VK_TRUE, UINT64_MAX));
+		if (!resources::write_ppm(m_capture_path.c_str(),
+			(const uint8_t*)m_context.readback_buffer.data, m_width, m_height))
+			LOG_ERROR("Frame capture failed:", m_capture_path);
+		m_capture_path.clear();
+	}
+	//PRESENT, no cpu wait here, the fence is waited on when this frame comes around again
+	if (!m_config.headless)
+	{
+		VkPresentInfoKHR present_info{};
+		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.pSwapchains = &m_context.swap_chain;
+		present_info.swapchainCount = 1;
+		present_info.pImageIndices = &image_idx;
+		present_info.pWaitSemaphores = &frame.submit_semaphore;
+		present_info.waitSemaphoreCount = 1;
+		PROFILE_ZONE("present");
+		VKCHECK(vkQueuePresentKHR(m_context.graphics_queue, &present_info));
+	}
 
+	m_context.frame_index = (m_context.frame_index + 1) % m_frames_in_flight;
 	return true;
 }
 
@@ -739,47 +1173,39 @@ auto dazai_engine::renderer::submit_info(VkCommandBuffer* cmd, uint32_t cmd_coun
 
 auto dazai_engine::renderer::alloc_image
 (VkDevice device,
-	VkPhysicalDevice physical_device,
 	uint32_t width,
 	uint32_t height,
-	VkFormat format) -> image
+	VkFormat format,
+	VkImageUsageFlags usage,
+	uint32_t mip_levels) -> image
 {
 	image image{};
 	VkImageCreateInfo image_info{};
 	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	image_info.imageType = VK_IMAGE_TYPE_2D;
-	image_info.mipLevels = 1;
+	image_info.mipLevels = mip_levels;
 	image_info.arrayLayers = 1;
 	image_info.format = format;
 	image_info.extent = { width,height,1 };
 	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
-	image_info.usage =
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | // image will be used for transferring data from cpu-gpu
-		VK_IMAGE_USAGE_SAMPLED_BIT; // image will be used for sampling in frag shader
+	image_info.usage = usage;
 	//image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	VKCHECK(vkCreateImage(device, &image_info, 0,
 		&image.vk_image));
 
 	VkMemoryRequirements mem_req{};
 	vkGetImageMemoryRequirements(device, image.vk_image, &mem_req);
-	VkPhysicalDeviceMemoryProperties mem_prop{};
-	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_prop);
-	VkMemoryAllocateInfo alloc_info{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.allocationSize = mem_req.size;
-	alloc_info.memoryTypeIndex = get_memory_type_index(physical_device,mem_req,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VKCHECK(vkAllocateMemory(device, &alloc_info, 0,
-		&image.memory));
+	//optimal tiling, kept apart from buffers for bufferImageGranularity
+	image.allocation = m_context.allocator.allocate(mem_req,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
 	VKCHECK(vkBindImageMemory(device,
-		image.vk_image, image.memory, 0));
+		image.vk_image, image.allocation.memory, image.allocation.offset));
 
 	return image;
 }
 
 auto dazai_engine::renderer::alloc_buffer(
 	VkDevice device,
-	VkPhysicalDevice physical_device,
 	uint32_t size,
 	VkBufferUsageFlags buffer_usage,
 	VkMemoryPropertyFlags mem_props) -> buffer
@@ -797,72 +1223,177 @@ auto dazai_engine::renderer::alloc_buffer(
 	VkMemoryRequirements mem_req{};
 	vkGetBufferMemoryRequirements(device, buffer.vk_buffer,
 		&mem_req);
-	VkPhysicalDeviceMemoryProperties mem_prop{};
-	vkGetPhysicalDeviceMemoryProperties(physical_device,
-		&mem_prop);
-	VkMemoryAllocateInfo alloc_info{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.allocationSize = mem_req.size;
-	alloc_info.memoryTypeIndex = 
-		get_memory_type_index(physical_device,
-		mem_req,
-		mem_props);
-
-	VKCHECK(vkAllocateMemory(device, &alloc_info, 0,
-		&buffer.memory));
-	//only map when we can write to memory from cpu
-	if (mem_props  & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-
-	{
-		VKCHECK(vkMapMemory(device, buffer.memory, 0, mem_req.size,
-			0, &buffer.data));
-	}
+	buffer.allocation = m_context.allocator.allocate(mem_req, mem_props, true);
+	//host visible blocks are persistently mapped by the allocator
+	buffer.data = buffer.allocation.data;
 	VKCHECK(vkBindBufferMemory(device, buffer.vk_buffer,
-		buffer.memory, 0));
+		buffer.allocation.memory, buffer.allocation.offset));
 	
 	return buffer;
 }
 
 
-auto dazai_engine::renderer::get_memory_type_index(
-	VkPhysicalDevice physical_device,
-	VkMemoryRequirements mem_reqs,
-	VkMemoryPropertyFlags mem_props) -> uint32_t
+auto dazai_engine::renderer::copy_to_buffer(buffer* buffer, void* data, uint32_t size) -> void
 {
-	uint32_t type_index = UINT32_MAX;
-	VkPhysicalDeviceMemoryProperties mem_prop{};
-	vkGetPhysicalDeviceMemoryProperties(physical_device,
-		&mem_prop);
-	VkMemoryAllocateInfo alloc_info{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.allocationSize = mem_reqs.size;
-	for (size_t i = 0; i < mem_prop.memoryTypeCount; i++)
+	PROFILE_ZONE("copy_to_buffer");
+	if (size > buffer->size)
 	{
-		if (mem_reqs.memoryTypeBits & (1 << i) &&
-			(mem_prop.memoryTypes[i].propertyFlags &
-				mem_props)
-			==
-			(mem_props))
-		{
-			type_index = i;
-			break;
-		}
+		LOG_ERROR("Buffer size is greater than size");
+		return;
+	}
+	if (buffer->data)
+	{
+		memcpy(buffer->data, data, size);
+	}
+	else
+	{
+		LOG_ERROR("Buffer data is null");
 	}
-	if (type_index == UINT32_MAX)
-		LOG_ERROR("Memory index Invalid");
-	return type_index;
 }
 
-auto dazai_engine::renderer::copy_to_buffer(buffer* buffer, void* data, uint32_t size) -> void
+auto dazai_engine::renderer::free_buffer(VkDevice device, buffer* buffer) -> void
 {
-	if (size > buffer->size)
+	vkDestroyBuffer(device, buffer->vk_buffer, 0);
+	m_context.allocator.free(&buffer->allocation);
+	*buffer = {};
+}
+
+auto dazai_engine::renderer::capture_frame(const char* path) -> void
+{
+	if (!m_config.headless)
+	{
+		LOG_WARNING("Frame capture needs headless mode");
+		return;
+	}
+	m_capture_path = path;
+}
+
+auto dazai_engine::renderer::get_memory_stats() -> gpu_allocator_stats
+{
+	return m_context.allocator.get_stats();
+}
+
+auto dazai_engine::renderer::alloc_transform_buffer(uint32_t size) -> buffer
+{
+	if (m_context.transform_device_local)
+	{
+		return alloc_buffer(m_context.device,
+			size,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	//transfer dst for the gpu solver's copy into the slice
+	return alloc_buffer(m_context.device,
+		size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
+
+auto dazai_engine::renderer::setup_staging_ring() -> void
+{
+	//regions are kept 256 byte aligned, enough for any copy offset
+	uint32_t region_size = m_context.staging_buffer.size / m_frames_in_flight / 256 * 256;
+	for (uint32_t f = 0; f < m_frames_in_flight; f++)
+	{
+		m_context.frames[f].staging_offset = f * region_size;
+		m_context.frames[f].staging_size = region_size;
+		m_context.frames[f].staging_head = 0;
+	}
+}
+
+auto dazai_engine::renderer::reserve_staging_ring(uint32_t size) -> bool
+{
+	if (size <= m_context.frames[0].staging_size)
+		return true;
+	uint64_t new_size = (uint64_t)m_context.staging_buffer.size * 2;
+	uint64_t required = ((uint64_t)size + 256) * m_frames_in_flight;
+	new_size = new_size > required ? new_size : required;
+	if (new_size > UINT32_MAX)
+	{
+		LOG_ERROR("Staging buffer too large:", new_size);
+		return false;
+	}
+	//other frames may still be copying out of their regions
+	VKCHECK(vkDeviceWaitIdle(m_context.device));
+	free_buffer(m_context.device, &m_context.staging_buffer);
+	m_context.staging_buffer = alloc_buffer(
+		m_context.device,
+		(uint32_t)new_size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		);
+	setup_staging_ring();
+	LOG_INFO("Staging buffer grown to bytes:", new_size);
+	return true;
+}
+
+auto dazai_engine::renderer::staging_alloc(frame_data& frame, uint32_t size, uint32_t alignment) -> uint32_t
+{
+	uint32_t head = (frame.staging_head + alignment - 1) / alignment * alignment;
+	if (head + (uint64_t)size > frame.staging_size)
+		return UINT32_MAX;
+	frame.staging_head = head + size;
+	return frame.staging_offset + head;
+}
+
+auto dazai_engine::renderer::transform_slice_size(uint32_t entity_count) -> uint64_t
+{
+	uint64_t size = sizeof(transform) * (uint64_t)entity_count;
+	uint64_t alignment = m_context.device_properties.limits.minStorageBufferOffsetAlignment;
+	alignment = alignment > 0 ? alignment : 1;
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+auto dazai_engine::renderer::reserve_transform_buffer(uint32_t entity_count) -> bool
+{
+	uint64_t required = transform_slice_size(entity_count);
+	if (required <= m_context.transform_slice_size)
+		return true;
+	//grow geometrically so a steadily growing sim reallocates rarely
+	uint64_t new_slice_size = transform_slice_size(
+		(uint32_t)(m_context.transform_slice_size / sizeof(transform)) * 2);
+	new_slice_size = new_slice_size > required ? new_slice_size : required;
+	if (new_slice_size * m_frames_in_flight > UINT32_MAX)
+	{
+		LOG_ERROR("Transform buffer too large:", new_slice_size * m_frames_in_flight);
+		return false;
+	}
+	//the descriptor set and old buffer may still be in use by frames in flight
+	VKCHECK(vkDeviceWaitIdle(m_context.device));
+	free_buffer(m_context.device, &m_context.transform_storage_buffer);
+	m_context.transform_slice_size = (uint32_t)new_slice_size;
+	m_context.transform_storage_buffer =
+		alloc_transform_buffer(m_context.transform_slice_size * m_frames_in_flight);
+	for (uint32_t f = 0; f < m_frames_in_flight; f++)
+		m_context.frames[f].transform_offset = f * m_context.transform_slice_size;
+	//rebind the new buffer in every frame's set, the range covers one slice
+	descriptor_info desc_info(m_context.transform_storage_buffer.vk_buffer,
+		0, m_context.transform_slice_size);
+	for (auto& frame : m_context.frames)
+	{
+		VkWriteDescriptorSet write = write_set(frame.descriptor_set,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &desc_info, 1, 1);
+		vkUpdateDescriptorSets(m_context.device, 1, &write, 0, 0);
+	}
+	//updating the sets invalidated the secondaries that bound them
+	if (m_config.prerecord_static_commands)
+		record_static_commands();
+	LOG_INFO("Transform buffer grown to bytes per frame:", new_slice_size);
+	return true;
+}
+
+auto dazai_engine::renderer::upload_transforms(buffer* buffer, uint32_t offset, simulation_state* state) -> void
+{
+	PROFILE_ZONE("upload transforms");
+	if (offset + sizeof(transform) * (uint64_t)state->entity_count > buffer->size)
 	{
 		LOG_ERROR("Buffer size is greater than size");
 		return;
 	}
 	if (buffer->data)
 	{
-		memcpy(buffer->data, data, size);
+		transform* slice = (transform*)((char*)buffer->data + offset);
+		state->particles.pack_transforms(slice, state->entity_count, state->interpolation);
 	}
 	else
 	{
@@ -870,6 +1401,443 @@ auto dazai_engine::renderer::copy_to_buffer(buffer* buffer, void* data, uint32_t
 	}
 }
 
+auto dazai_engine::renderer::record_draw(VkCommandBuffer cmd, frame_data& frame,
+	uint32_t instance_count, bool indirect) -> void
+{
+	VkRect2D scissor{};
+	scissor.extent = { m_width,m_height };
+	VkViewport viewport{};
+	viewport.width = m_width;
+	viewport.height = m_height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	vkCmdSetScissor(cmd,0,1,&scissor);
+
+	vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
+		m_context.pipeline_layout,
+		0,1, &frame.descriptor_set 
+		,1,&frame.transform_offset);
+
+	vkCmdBindIndexBuffer(cmd,m_context.ibo.vk_buffer,
+		0,VK_INDEX_TYPE_UINT32);
+	vkCmdBindPipeline(cmd,
+		VK_PIPELINE_BIND_POINT_GRAPHICS, m_context.pipeline);
+	if (indirect)
+		vkCmdDrawIndexedIndirect(cmd, m_context.draw_indirect_buffer.vk_buffer,
+			frame.indirect_offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexed(cmd,6,instance_count,
+			0,0,0);
+}
+
+auto dazai_engine::renderer::record_static_commands() -> void
+{
+	for (auto& frame : m_context.frames)
+		record_static_commands(frame);
+}
+
+auto dazai_engine::renderer::record_static_commands(frame_data& frame) -> void
+{
+	//secondaries inside a render pass must say which one they continue
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = m_context.render_pass;
+	inheritance.subpass = 0;
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	begin_info.pInheritanceInfo = &inheritance;
+	VKCHECK(vkBeginCommandBuffer(frame.static_cmd, &begin_info));
+	record_draw(frame.static_cmd, frame, 0, true);
+	VKCHECK(vkEndCommandBuffer(frame.static_cmd));
+}
+
+auto dazai_engine::renderer::stream_texture(const char* path) -> void
+{
+	m_streamer.request(path);
+}
+
+auto dazai_engine::renderer::update_streamed_textures(frame_data& frame, bool wait) -> void
+{
+	//captures want the final texture, everything else never waits for it
+	if (wait)
+		m_streamer.flush(m_context.graphics_queue, m_streamed);
+	else
+		m_streamer.poll(m_context.graphics_queue, m_streamed);
+	for (auto& texture : m_streamed)
+	{
+		//frames that haven't come around yet may still sample the old one
+		m_context.retired_textures.push_back({ m_context.image, m_context.texture_generation + 1 });
+		m_context.image = texture.image;
+		m_context.image_format = texture.format;
+		m_context.image_mip_count = texture.mip_count;
+		m_context.texture_generation++;
+		if (texture.needs_acquire)
+			m_context.pending_acquires.push_back(texture);
+	}
+	m_streamed.clear();
+	//the fence signalled, no submitted work reads this frame's set anymore
+	if (frame.texture_generation != m_context.texture_generation)
+	{
+		descriptor_info desc_info(m_context.sampler, m_context.image.view);
+		VkWriteDescriptorSet write = write_set(frame.descriptor_set,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &desc_info, 2, 1);
+		vkUpdateDescriptorSets(m_context.device, 1, &write, 0, 0);
+		frame.texture_generation = m_context.texture_generation;
+		if (m_config.prerecord_static_commands)
+			record_static_commands(frame);
+	}
+	//an image is unused once every frame rebound past it
+	uint32_t oldest_generation = m_context.texture_generation;
+	for (auto& f : m_context.frames)
+		oldest_generation = f.texture_generation < oldest_generation ? f.texture_generation : oldest_generation;
+	for (size_t i = 0; i < m_context.retired_textures.size();)
+	{
+		retired_texture& retired = m_context.retired_textures[i];
+		if (retired.generation > oldest_generation)
+		{
+			i++;
+			continue;
+		}
+		vkDestroyImageView(m_context.device, retired.image.view, 0);
+		vkDestroyImage(m_context.device, retired.image.vk_image, 0);
+		m_context.allocator.free(&retired.image.allocation);
+		m_context.retired_textures.erase(m_context.retired_textures.begin() + i);
+	}
+}
+
+auto dazai_engine::renderer::create_gpu_solver() -> bool
+{
+	gpu_solver_context& solver = m_context.gpu_solver;
+	asset_data c_code;
+	if (!resources::load_asset("shaders/particles.comp.spv", &c_code))
+		return false;
+	VkShaderModule c_module;
+	VkShaderModuleCreateInfo cs_info{};
+	cs_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	cs_info.pCode = (const uint32_t*)c_code.bytes.data();
+	cs_info.codeSize = c_code.bytes.size();
+	VKCHECK(vkCreateShaderModule(m_context.device, &cs_info, 0, &c_module));
+	//src, dst, cell counts, cell starts, particle bins, cell entries
+	VkDescriptorSetLayoutBinding bindings[6];
+	for (uint32_t b = 0; b < ARRAYSIZE(bindings); b++)
+		bindings[b] = layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_SHADER_STAGE_COMPUTE_BIT, 1, b);
+	VkDescriptorSetLayoutCreateInfo set_layout_info{};
+	set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_info.bindingCount = ARRAYSIZE(bindings);
+	set_layout_info.pBindings = bindings;
+	VKCHECK(vkCreateDescriptorSetLayout(m_context.device, &set_layout_info, 0,
+		&solver.set_layout));
+	//step params + pass index
+	VkPushConstantRange push_range{};
+	push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_range.size = sizeof(particle_step_params) + sizeof(int32_t);
+	VkPipelineLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &solver.set_layout;
+	layout_info.pushConstantRangeCount = 1;
+	layout_info.pPushConstantRanges = &push_range;
+	VKCHECK(vkCreatePipelineLayout(m_context.device, &layout_info,
+		0, &solver.pipeline_layout));
+	VkComputePipelineCreateInfo cp_info{};
+	cp_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	cp_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	cp_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	cp_info.stage.module = c_module;
+	cp_info.stage.pName = "main";
+	cp_info.layout = solver.pipeline_layout;
+	VkResult result = vkCreateComputePipelines(m_context.device, m_context.pipeline_cache,
+		1, &cp_info, 0, &solver.pipeline);
+	vkDestroyShaderModule(m_context.device, c_module, 0);
+	if (result != VK_SUCCESS)
+	{
+		LOG_ERROR("Compute pipeline creation failed:", result);
+		return false;
+	}
+	VkDescriptorPoolSize pool_size{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * ARRAYSIZE(bindings) };
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = 2;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	VKCHECK(vkCreateDescriptorPool(m_context.device, &pool_info,
+		0, &solver.descriptor_pool));
+	VkDescriptorSetLayout set_layouts[2] = { solver.set_layout, solver.set_layout };
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.pSetLayouts = set_layouts;
+	alloc_info.descriptorSetCount = 2;
+	alloc_info.descriptorPool = solver.descriptor_pool;
+	VKCHECK(vkAllocateDescriptorSets(m_context.device, &alloc_info, solver.sets));
+	return true;
+}
+
+auto dazai_engine::renderer::seed_gpu_particles(simulation_state* state, float cell_size) -> bool
+{
+	if (!m_gpu_simulation)
+		return false;
+	gpu_solver_context& solver = m_context.gpu_solver;
+	uint32_t count = state->entity_count;
+	if (count == 0)
+	{
+		LOG_ERROR("Nothing to seed the GPU solver with");
+		return false;
+	}
+	VKCHECK(vkDeviceWaitIdle(m_context.device));
+	buffer* solver_buffers[] = { &solver.particles[0], &solver.particles[1],
+		&solver.cell_count, &solver.cell_start, &solver.particle_bin, &solver.cell_entries };
+	for (buffer* b : solver_buffers)
+		free_buffer(m_context.device, b);
+	solver.particle_count = count;
+	solver.current = 0;
+	//one border cell so the clamped edge cells aren't shared with on screen ones
+	solver.grid_width = (uint32_t)(m_width / cell_size) + 2;
+	solver.grid_height = (uint32_t)(m_height / cell_size) + 2;
+	uint32_t cell_total = solver.grid_width * solver.grid_height;
+	uint32_t particle_bytes = sizeof(transform) * count;
+	for (int k = 0; k < 2; k++)
+		solver.particles[k] = alloc_buffer(m_context.device,
+			particle_bytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	solver.cell_count = alloc_buffer(m_context.device,
+		sizeof(uint32_t) * cell_total,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	solver.cell_start = alloc_buffer(m_context.device,
+		sizeof(uint32_t) * (cell_total + 1),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	solver.particle_bin = alloc_buffer(m_context.device,
+		sizeof(uint32_t) * 2 * count,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	solver.cell_entries = alloc_buffer(m_context.device,
+		sizeof(uint32_t) * count,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	for (buffer* b : solver_buffers)
+	{
+		if (b->allocation.memory == VK_NULL_HANDLE)
+		{
+			LOG_ERROR("GPU solver buffer allocation failed, particles:", count);
+			return false;
+		}
+	}
+	//both sets share the grid buffers and swap src/dst
+	for (int k = 0; k < 2; k++)
+	{
+		descriptor_info infos[] =
+		{
+			descriptor_info(solver.particles[k].vk_buffer),
+			descriptor_info(solver.particles[1 - k].vk_buffer),
+			descriptor_info(solver.cell_count.vk_buffer),
+			descriptor_info(solver.cell_start.vk_buffer),
+			descriptor_info(solver.particle_bin.vk_buffer),
+			descriptor_info(solver.cell_entries.vk_buffer)
+		};
+		VkWriteDescriptorSet writes[ARRAYSIZE(infos)];
+		for (uint32_t b = 0; b < ARRAYSIZE(infos); b++)
+			writes[b] = write_set(solver.sets[k], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				&infos[b], b, 1);
+		vkUpdateDescriptorSets(m_context.device, ARRAYSIZE(writes), writes, 0, 0);
+	}
+	//starting positions go through a temporary staging buffer
+	buffer upload = alloc_buffer(m_context.device,
+		particle_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	if (upload.data == nullptr)
+	{
+		LOG_ERROR("GPU solver upload buffer allocation failed");
+		return false;
+	}
+	state->particles.pack_transforms((transform*)upload.data, count);
+	VkCommandBuffer cmd = begin_one_time_commands();
+	VkBufferCopy copy_region{};
+	copy_region.size = particle_bytes;
+	vkCmdCopyBuffer(cmd, upload.vk_buffer, solver.particles[0].vk_buffer, 1, &copy_region);
+	end_one_time_commands(cmd);
+	free_buffer(m_context.device, &upload);
+	m_gpu_steps.clear();
+	LOG_INFO("GPU solver seeded, particles:", count, "grid:", solver.grid_width, solver.grid_height);
+	return true;
+}
+
+auto dazai_engine::renderer::queue_gpu_step(const particle_step_params& params) -> void
+{
+	m_gpu_steps.push_back(params);
+}
+
+auto dazai_engine::renderer::gpu_simulation_enabled() const -> bool
+{
+	return m_gpu_simulation;
+}
+
+auto dazai_engine::renderer::read_gpu_particles(std::vector<transform>& out) -> bool
+{
+	gpu_solver_context& solver = m_context.gpu_solver;
+	if (!m_gpu_simulation || solver.particle_count == 0)
+		return false;
+	uint32_t particle_bytes = sizeof(transform) * solver.particle_count;
+	buffer download = alloc_buffer(m_context.device,
+		particle_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	if (download.data == nullptr)
+	{
+		LOG_ERROR("GPU solver readback buffer allocation failed");
+		return false;
+	}
+	//frames in flight may still be stepping
+	VKCHECK(vkDeviceWaitIdle(m_context.device));
+	VkCommandBuffer cmd = begin_one_time_commands();
+	VkBufferCopy copy_region{};
+	copy_region.size = particle_bytes;
+	vkCmdCopyBuffer(cmd, solver.particles[solver.current].vk_buffer,
+		download.vk_buffer, 1, &copy_region);
+	VkMemoryBarrier host_barrier{};
+	host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &host_barrier, 0, 0, 0, 0);
+	end_one_time_commands(cmd);
+	out.resize(solver.particle_count);
+	memcpy(out.data(), download.data, particle_bytes);
+	free_buffer(m_context.device, &download);
+	return true;
+}
+
+auto dazai_engine::renderer::record_gpu_steps(VkCommandBuffer cmd, frame_data& frame) -> void
+{
+	gpu_solver_context& solver = m_context.gpu_solver;
+	//every pass reads what the previous one wrote
+	auto compute_barrier = [cmd](VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+		VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = src_access;
+		barrier.dstAccessMask = dst_access;
+		vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 1, &barrier, 0, 0, 0, 0);
+	};
+	struct
+	{
+		particle_step_params params;
+		int32_t pass;
+	} push{};
+	const VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	const VkAccessFlags rw = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	uint32_t particle_groups = (solver.particle_count + 255) / 256;
+	if (!m_gpu_steps.empty())
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, solver.pipeline);
+	for (const particle_step_params& params : m_gpu_steps)
+	{
+		push.params = params;
+		push.params.particle_count = (int)solver.particle_count;
+		push.params.grid_width = (int)solver.grid_width;
+		push.params.grid_height = (int)solver.grid_height;
+		//previous frame's copy or the last step may still read the buffers
+		compute_barrier(compute | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdFillBuffer(cmd, solver.cell_count.vk_buffer, 0, VK_WHOLE_SIZE, 0);
+		compute_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, compute, rw);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+			solver.pipeline_layout, 0, 1, &solver.sets[solver.current], 0, 0);
+		//count, scan, scatter, solve
+		uint32_t groups[] = { particle_groups, 1, particle_groups, particle_groups };
+		for (int32_t pass = 0; pass < 4; pass++)
+		{
+			push.pass = pass;
+			vkCmdPushConstants(cmd, solver.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+				0, sizeof(push), &push);
+			vkCmdDispatch(cmd, groups[pass], 1, 1);
+			compute_barrier(compute, VK_ACCESS_SHADER_WRITE_BIT, compute, rw);
+		}
+		solver.current = 1 - solver.current;
+	}
+	m_gpu_steps.clear();
+	//latest particles into this frame's slice for the vertex shader
+	compute_barrier(compute, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	VkBufferCopy copy_region{};
+	copy_region.dstOffset = frame.transform_offset;
+	copy_region.size = sizeof(transform) * solver.particle_count;
+	vkCmdCopyBuffer(cmd, solver.particles[solver.current].vk_buffer,
+		m_context.transform_storage_buffer.vk_buffer, 1, &copy_region);
+	compute_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+auto dazai_engine::renderer::write_timestamp(VkCommandBuffer cmd, frame_data& frame,
+	gpu_timing_zone zone, bool begin) -> void
+{
+	if (frame.timestamp_pool == VK_NULL_HANDLE)
+		return;
+	vkCmdWriteTimestamp(cmd,
+		begin ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		frame.timestamp_pool, zone * 2 + (begin ? 0 : 1));
+	frame.timestamp_zones |= 1u << zone;
+}
+
+auto dazai_engine::renderer::read_timestamps(frame_data& frame) -> void
+{
+	static const char* zone_names[gpu_zone_count] =
+	{
+		"gpu frame", "gpu solver", "gpu upload", "gpu render pass"
+	};
+	frame.timestamps_pending = false;
+	//value + availability per query, unwritten zones stay unavailable
+	uint64_t results[gpu_zone_count * 2][2]{};
+	VkResult result = vkGetQueryPoolResults(m_context.device, frame.timestamp_pool,
+		0, gpu_zone_count * 2, sizeof(results), results, sizeof(results[0]),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+	{
+		LOG_ERROR("Timestamp readback failed:", result);
+		return;
+	}
+	uint64_t valid_mask = m_context.timestamp_valid_bits >= 64 ?
+		UINT64_MAX : ((uint64_t)1 << m_context.timestamp_valid_bits) - 1;
+	double period = m_context.device_properties.limits.timestampPeriod;
+	uint64_t frame_begin = results[gpu_zone_frame * 2][0];
+	for (uint32_t zone = 0; zone < gpu_zone_count; zone++)
+	{
+		uint64_t* begin = results[zone * 2];
+		uint64_t* end = results[zone * 2 + 1];
+		if (!(frame.timestamp_zones & (1u << zone)) || begin[1] == 0 || end[1] == 0)
+			continue;
+		//gpu ticks have no relation to the cpu clock, start the frame at submit
+		uint64_t start_ns = frame.timestamp_submit_ns +
+			(uint64_t)(((begin[0] - frame_begin) & valid_mask) * period);
+		uint64_t duration_ns = (uint64_t)(((end[0] - begin[0]) & valid_mask) * period);
+		profiler::record(m_context.gpu_track, zone_names[zone], start_ns, start_ns + duration_ns);
+	}
+}
+
+auto dazai_engine::renderer::begin_one_time_commands() -> VkCommandBuffer
+{
+	VkCommandBuffer cmd;
+	VkCommandBufferAllocateInfo cmd_alloc = cmd_alloc_info(m_context.command_pool);
+	VKCHECK(vkAllocateCommandBuffers(m_context.device, &cmd_alloc, &cmd));
+	VkCommandBufferBeginInfo begin_info = cmd_begin_info();
+	VKCHECK(vkBeginCommandBuffer(cmd, &begin_info));
+	return cmd;
+}
+
+auto dazai_engine::renderer::end_one_time_commands(VkCommandBuffer cmd) -> void
+{
+	VKCHECK(vkEndCommandBuffer(cmd));
+	VkFence fence;
+	VkFenceCreateInfo f_info = fence_info();
+	VKCHECK(vkCreateFence(m_context.device, &f_info, 0, &fence));
+	VkSubmitInfo sub_info = submit_info(&cmd);
+	VKCHECK(vkQueueSubmit(m_context.graphics_queue, 1, &sub_info, fence));
+	VKCHECK(vkWaitForFences(m_context.device, 1, &fence, VK_TRUE, UINT64_MAX));
+	vkDestroyFence(m_context.device, fence, 0);
+	vkFreeCommandBuffers(m_context.device, m_context.command_pool, 1, &cmd);
+}
+
 auto dazai_engine::renderer::layout_binding
 (
 	VkDescriptorType type,
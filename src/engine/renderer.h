@@ -1,88 +1,274 @@
 #pragma once
 #include "glfw_window.h"
 #include <optional>
+#include <string>
 #include <vector>
+#include "texture_streamer.h"
 #include "vk_types.h"
 #include "../simulation/simulation.h"
 namespace dazai_engine
 {
+	struct profile_track;
+
+	uint32_t constexpr DEFAULT_FRAMES_IN_FLIGHT = 2;
+	//relative to the working directory, written on shutdown
+	constexpr const char* DEFAULT_PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+	//gpu work measured with timestamp queries, a begin/end pair each
+	enum gpu_timing_zone : uint32_t
+	{
+		gpu_zone_frame,
+		gpu_zone_solver,
+		gpu_zone_upload,
+		gpu_zone_render_pass,
+		gpu_zone_count
+	};
+
+	struct renderer_config
+	{
+		uint32_t frames_in_flight{ DEFAULT_FRAMES_IN_FLIGHT };
+		//record pipeline/descriptor/index buffer binds and an indirect draw
+		//once into a secondary command buffer per frame, the primary only
+		//updates the draw arguments and executes it
+		bool prerecord_static_commands{ false };
+		//keep transforms in device local memory and upload them through the
+		//staging ring, ignored on uma devices where host visible memory is
+		//already what the gpu reads
+		bool device_local_transforms{ true };
+		//render into offscreen images instead of a swapchain, needs no window
+		//or surface so it runs on display-less machines and software icds
+		bool headless{ false };
+		//step particles with the particles.comp compute solver on the gpu
+		//instead of uploading cpu results, see seed_gpu_particles
+		bool gpu_simulation{ false };
+		//timestamp queries around the frame's gpu work, reported on the
+		//profiler's "gpu" track. ignored when the queue has no timestamps
+		bool gpu_timestamps{ true };
+		//upload streamed textures on a transfer only queue family when the
+		//device has one, off = always through the graphics queue
+		bool dedicated_transfer_queue{ true };
+		//VkPipelineCache loaded at init and saved on destruction, a cache
+		//from another gpu or driver is ignored. null = no cache file
+		const char* pipeline_cache_path{ DEFAULT_PIPELINE_CACHE_PATH };
+		uint32_t headless_width{ 500 };
+		uint32_t headless_height{ 720 };
+	};
+
+	//everything a frame needs while the gpu may still be working on the previous ones
+	struct frame_data
+	{
+		//reset as a whole once the frame's fence signals
+		VkCommandPool command_pool;
+		VkCommandBuffer cmd;
+		//pre-recorded secondary, only used with prerecord_static_commands
+		VkCommandBuffer static_cmd;
+		VkSemaphore acquire_semaphore;
+		VkSemaphore submit_semaphore;
+		VkFence in_flight_fence;
+		//byte offset of this frame's slice in the transform storage buffer
+		uint32_t transform_offset;
+		//byte offset of this frame's VkDrawIndexedIndirectCommand
+		uint32_t indirect_offset;
+		//this frame's region of the staging ring, bump allocated and
+		//rewound once the frame's fence has signalled
+		uint32_t staging_offset;
+		uint32_t staging_size;
+		uint32_t staging_head;
+		//gpu_zone_count begin/end pairs, read back once the fence signals
+		VkQueryPool timestamp_pool;
+		//cpu time at submit, anchors the gpu timestamps on the trace timeline
+		uint64_t timestamp_submit_ns;
+		bool timestamps_pending;
+		//zones written this frame, bit per gpu_timing_zone
+		uint32_t timestamp_zones;
+		//per frame so a new texture is bound once this frame's fence signalled
+		VkDescriptorSet descriptor_set;
+		//vk_context::texture_generation the set was last written with
+		uint32_t texture_generation;
+	};
+
+	//texture replaced by a streamed one, destroyed once every frame's
+	//texture_generation reached generation
+	struct retired_texture
+	{
+		dazai_engine::image image;
+		uint32_t generation;
+	};
+
+	//compute particle solver state, only used with gpu_simulation
+	struct gpu_solver_context
+	{
+		VkDescriptorSetLayout set_layout;
+		VkPipelineLayout pipeline_layout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptor_pool;
+		//sets[k] reads particles[k] and writes particles[1 - k]
+		VkDescriptorSet sets[2];
+		buffer particles[2];
+		//index into particles holding the latest step
+		uint32_t current;
+		uint32_t particle_count;
+		//grid over the render area, cell size is the interaction radius
+		buffer cell_count;
+		buffer cell_start;
+		buffer particle_bin;
+		buffer cell_entries;
+		uint32_t grid_width;
+		uint32_t grid_height;
+	};
+
 	struct vk_context
 	{
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debug_messenger;
-		//surface
-		VkSurfaceKHR surface;
+		//surface, null in headless mode
+		VkSurfaceKHR surface{ VK_NULL_HANDLE };
 		VkSurfaceFormatKHR surface_format;
 		//devices
 		VkPhysicalDevice physical_device;
+		VkPhysicalDeviceProperties device_properties;
+		//textureCompressionBC was enabled on the device, bc textures are rejected without it
+		bool texture_compression_bc{ false };
 		VkDevice device;
-		// swap chain
-		VkSwapchainKHR swap_chain;
+		gpu_allocator allocator;
+		// swap chain, null in headless mode
+		VkSwapchainKHR swap_chain{ VK_NULL_HANDLE };
 		uint32_t sc_image_count;
 		std::vector<VkImage> sc_images;
 		//sc image views
 		std::vector<VkImageView> sc_image_views;
+		//headless render targets, sc_images/sc_image_views point into these
+		std::vector<dazai_engine::image> offscreen_images;
+		//host visible copy of a headless target for frame captures
+		buffer readback_buffer;
 		//renderpass
 		VkRenderPass render_pass;
 		//framebuffers
 		std::vector<VkFramebuffer> frame_buffers;
+		//shared by every pipeline, persisted with pipeline_cache_path
+		VkPipelineCache pipeline_cache{ VK_NULL_HANDLE };
 		//pipeline
 		VkPipeline pipeline;
 		//pipeline layout
 		VkPipelineLayout pipeline_layout;
 		//command pool
 		VkCommandPool command_pool;
-		//semaphores
-		VkSemaphore acquire_semaphore{};
-		VkSemaphore submit_semaphore{};
-		//fences
-		VkFence submit_queue_fence{};
+		//frames in flight
+		std::vector<frame_data> frames;
+		uint32_t frame_index{ 0 };
+		//fence of the last frame that rendered to each swapchain image
+		std::vector<VkFence> image_fences;
 		//queue family indices
 		std::optional<uint32_t> graphic_family_queue_index;
 		VkQueue graphics_queue;
+		//transfer only family, unset when the device has none
+		std::optional<uint32_t> transfer_family_queue_index;
+		VkQueue transfer_queue{ VK_NULL_HANDLE };
+		//0 = the graphics queue can't write timestamps
+		uint32_t timestamp_valid_bits{ 0 };
+		profile_track* gpu_track{ nullptr };
 		//staging buffer
 		buffer staging_buffer;
-		//transform storage buffer
+		//transform storage buffer, one slice per frame in flight
+		//bound through a dynamic offset
 		buffer transform_storage_buffer;
+		uint32_t transform_slice_size;
+		//transforms live in device local memory and are copied from staging
+		bool transform_device_local;
+		//indirect draw arguments, one command per frame in flight
+		buffer draw_indirect_buffer;
 		buffer global_ubo;
 		buffer ibo;
 		//descriptor pool
 		VkSampler sampler;
 		VkDescriptorPool descriptor_pool;
-		//temporary
-		//TODO: needs to be abstracted
-		image image;
+		//sprite texture, a placeholder until the streamed one is in
+		dazai_engine::image image;
+		VkFormat image_format;
+		uint32_t image_mip_count;
+		//bumped every time image is replaced
+		uint32_t texture_generation;
+		std::vector<retired_texture> retired_textures;
+		//streamed textures whose acquire barrier goes in the next frame
+		std::vector<streamed_texture> pending_acquires;
 		VkDescriptorSetLayout set_layout;
-		VkDescriptorSet descriptor_set;
+		gpu_solver_context gpu_solver;
 	};
 
 	class renderer
 	{
 	public:
-		renderer(glfw_window* window);
+		//window may be null with config.headless
+		renderer(glfw_window* window, renderer_config config = {});
 		~renderer();
 		auto init() -> bool;
 		auto render(simulation_state* state) -> bool;
+		//uploads state's particles as the starting point of the gpu solver,
+		//from then on render() draws the solver's particles and ignores
+		//the cpu ones. false if gpu simulation is off or unavailable
+		auto seed_gpu_particles(simulation_state* state, float cell_size) -> bool;
+		//adds one solver step to the next rendered frame
+		auto queue_gpu_step(const particle_step_params& params) -> void;
+		//copies the solver's latest particles back, waits for the gpu
+		auto read_gpu_particles(std::vector<transform>& out) -> bool;
+		auto gpu_simulation_enabled() const -> bool;
+		//writes the next rendered frame to path as a ppm, headless only
+		auto capture_frame(const char* path) -> void;
+		//blocks, bytes and fragmentation of the gpu memory sub allocator
+		auto get_memory_stats() -> gpu_allocator_stats;
+		//loads a dds in the background and swaps it in for the sprite
+		//texture once it is on the gpu
+		auto stream_texture(const char* path) -> void;
 	private:
 		auto alloc_image
 		(VkDevice device,
-			VkPhysicalDevice physical_device,
 			uint32_t width,
 			uint32_t height,
-			VkFormat format) -> image;
+			VkFormat format,
+			VkImageUsageFlags usage =
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			uint32_t mip_levels = 1) -> image;
 		auto alloc_buffer(VkDevice device,
-			VkPhysicalDevice physical_device,
 			uint32_t size,
 			VkBufferUsageFlags buffer_usage,
 			VkMemoryPropertyFlags mem_props) -> buffer;
-		auto get_memory_type_index(VkPhysicalDevice device,
-			VkMemoryRequirements mem_reqs,
-			VkMemoryPropertyFlags mem_props) -> uint32_t;
+		auto create_swapchain() -> bool;
+		//seeds the cache from pipeline_cache_path if the file was written by
+		//this gpu and driver, otherwise starts empty
+		auto create_pipeline_cache() -> void;
+		auto save_pipeline_cache() -> void;
+		//pipeline and descriptor layout of particles.comp
+		auto create_gpu_solver() -> bool;
+		//queued solver steps + copy of the result into the frame's transform slice
+		auto record_gpu_steps(VkCommandBuffer cmd, frame_data& frame) -> void;
+		//one off command buffer, end_one_time_commands submits and waits
+		auto begin_one_time_commands() -> VkCommandBuffer;
+		auto end_one_time_commands(VkCommandBuffer cmd) -> void;
+		//begin = true writes the zone's first query at top of pipe, false
+		//the second at bottom of pipe
+		auto write_timestamp(VkCommandBuffer cmd, frame_data& frame, gpu_timing_zone zone, bool begin) -> void;
+		//results of the frame's last submit, only call once its fence signalled
+		auto read_timestamps(frame_data& frame) -> void;
+		//offscreen color targets + readback buffer for headless mode
+		auto create_offscreen_targets() -> bool;
 		auto cmd_begin_info() -> VkCommandBufferBeginInfo;
 		auto cmd_alloc_info(VkCommandPool pool) -> VkCommandBufferAllocateInfo;
 		auto fence_info(VkFenceCreateFlags flags = 0) -> VkFenceCreateInfo;
 		auto submit_info(VkCommandBuffer* cmd, uint32_t cmd_count = 1) -> VkSubmitInfo;
 		auto copy_to_buffer(buffer* buffer, void* data, uint32_t size) -> void;
+		auto upload_transforms(buffer* buffer, uint32_t offset, simulation_state* state) -> void;
+		//slice size for entity_count transforms, aligned for dynamic offsets
+		auto transform_slice_size(uint32_t entity_count) -> uint64_t;
+		auto free_buffer(VkDevice device, buffer* buffer) -> void;
+		auto alloc_transform_buffer(uint32_t size) -> buffer;
+		//splits the staging buffer into one region per frame in flight
+		auto setup_staging_ring() -> void;
+		//grows the staging buffer so every frame region holds at least size bytes
+		auto reserve_staging_ring(uint32_t size) -> bool;
+		//returns the offset in staging_buffer or UINT32_MAX if the frame region is full
+		auto staging_alloc(frame_data& frame, uint32_t size, uint32_t alignment = 16) -> uint32_t;
+		//reallocates the transform buffer and rebinds it if entity_count doesn't fit
+		auto reserve_transform_buffer(uint32_t entity_count) -> bool;
 		auto layout_binding
 		(
 			VkDescriptorType type,
@@ -90,6 +276,15 @@ namespace dazai_engine
 			uint32_t count,
 			uint32_t binding_number
 		) -> VkDescriptorSetLayoutBinding;
+		//viewport, binds and draw for the sprite pass, indirect reads the
+		//instance count from the frame's draw_indirect_buffer slot
+		auto record_draw(VkCommandBuffer cmd, frame_data& frame,
+			uint32_t instance_count, bool indirect) -> void;
+		auto record_static_commands() -> void;
+		auto record_static_commands(frame_data& frame) -> void;
+		//takes finished uploads from the streamer and rebinds the frame's
+		//set if the texture changed, wait blocks until requests are loaded
+		auto update_streamed_textures(frame_data& frame, bool wait) -> void;
 		auto write_set
 		(
 			VkDescriptorSet set,
@@ -100,6 +295,19 @@ namespace dazai_engine
 		) -> VkWriteDescriptorSet;
 
 		glfw_window* m_window;
+		renderer_config m_config;
+		uint32_t m_frames_in_flight;
+		//render target size, the window's or the headless config's
+		uint32_t m_width;
+		uint32_t m_height;
+		//set by capture_frame, cleared once the frame is on disk
+		std::string m_capture_path;
+		//cleared if the compute solver couldn't be created
+		bool m_gpu_simulation;
+		std::vector<particle_step_params> m_gpu_steps;
 		vk_context m_context;
+		texture_streamer m_streamer;
+		//scratch for update_streamed_textures
+		std::vector<streamed_texture> m_streamed;
 	};
 }
\ No newline at end of file
@@ -1,35 +1,208 @@
 #include "resources.h"
 #include "logger.h"
 #include "dds.h"
+#include "asset_pack.h"
+#include <cstring>
+#include <vector>
 
-auto dazai_engine::resources::read_raw_file(const char* filename, uint32_t* length)-> char*
+namespace
+{
+	//only written by mount_pack before assets load, read from any thread after
+	dazai_engine::asset_pack g_asset_pack;
+}
+
+auto dazai_engine::resources::map_file(const char* filename, mapped_file* out)-> bool
 {
 	auto resolved_path = RESOURCES + std::string(filename);
-	char* result = nullptr;
-	std::ifstream file(resolved_path, std::ios::ate | std::ios::binary);
-	if (!file.is_open())
+	if (!out->open(resolved_path.c_str()))
+	{
+		LOG_ERROR("Failed to map file:", resolved_path);
+		return false;
+	}
+	return true;
+}
+
+auto dazai_engine::resources::mount_pack(const char* path)-> bool
+{
+	return g_asset_pack.open(path);
+}
+
+auto dazai_engine::resources::load_asset(const char* filename, asset_data* out)-> bool
+{
+	if (g_asset_pack.is_open())
+	{
+		if (g_asset_pack.find(filename))
+			return g_asset_pack.read(filename, &out->storage, &out->bytes);
+		LOG_WARNING("Asset not in pack, loading the loose file:", filename);
+	}
+	if (!map_file(filename, &out->file))
+		return false;
+	out->bytes = out->file.bytes();
+	return true;
+}
+
+auto dazai_engine::resources::parse_dds(std::span<const uint8_t> bytes, dds_texture* out)-> bool
+{
+	uint32_t magic = 0;
+	if (bytes.size() < sizeof(magic) + sizeof(DDSHeader))
+	{
+		LOG_ERROR("DDS file too small, bytes:", bytes.size());
+		return false;
+	}
+	memcpy(&magic, bytes.data(), sizeof(magic));
+	const DDSHeader* header = (const DDSHeader*)(bytes.data() + sizeof(magic));
+	if (magic != DDS_MAGIC || header->Size != DDS_HEADER_SIZE ||
+		header->ddspf.dwSize != DDS_PIXEL_FORMAT_SIZE)
+	{
+		LOG_ERROR("Not a DDS file");
+		return false;
+	}
+	if (header->Width == 0 || header->Height == 0)
+	{
+		LOG_ERROR("DDS has no pixels:", header->Width, header->Height);
+		return false;
+	}
+	uint64_t header_bytes = sizeof(magic) + sizeof(DDSHeader);
+	const DDSPixelFormat& pf = header->ddspf;
+	bool found = true;
+	out->srgb = false;
+	if ((pf.dwFlags & DDPF_FOURCC) && pf.dwFourCC == DDS_FOURCC_DX10)
+	{
+		if (bytes.size() < header_bytes + sizeof(DDSHeaderDX10))
+		{
+			LOG_ERROR("DDS DX10 header truncated");
+			return false;
+		}
+		const DDSHeaderDX10* dx10 = (const DDSHeaderDX10*)(bytes.data() + header_bytes);
+		header_bytes += sizeof(DDSHeaderDX10);
+		if (dx10->arraySize > 1)
+			LOG_WARNING("DDS texture arrays are not supported, using the first layer");
+		switch (dx10->dxgiFormat)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: out->srgb = true; [[fallthrough]];
+		case DXGI_FORMAT_R8G8B8A8_UNORM: out->format = dds_format::rgba8; break;
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: out->srgb = true; [[fallthrough]];
+		case DXGI_FORMAT_B8G8R8A8_UNORM: out->format = dds_format::bgra8; break;
+		case DXGI_FORMAT_BC1_UNORM_SRGB: out->srgb = true; [[fallthrough]];
+		case DXGI_FORMAT_BC1_UNORM: out->format = dds_format::bc1; break;
+		case DXGI_FORMAT_BC3_UNORM_SRGB: out->srgb = true; [[fallthrough]];
+		case DXGI_FORMAT_BC3_UNORM: out->format = dds_format::bc3; break;
+		case DXGI_FORMAT_BC7_UNORM_SRGB: out->srgb = true; [[fallthrough]];
+		case DXGI_FORMAT_BC7_UNORM: out->format = dds_format::bc7; break;
+		default: found = false; break;
+		}
+	}
+	else if (pf.dwFlags & DDPF_FOURCC)
 	{
-		//TODO: ASSERT
-		LOG_ERROR("Failed to open file:", resolved_path);
-		return result;
-	}
-	//size in bytes
-	std::streamsize file_size = file.tellg();
-	//move cursor to start
-	file.seekg(0);
-	//allocate memory
-	result = new char[file_size];
-	file.read(result, file_size);
-	file.close();
-	//set length
-	if (length != nullptr)
-		*length = static_cast<int>(file_size);// cast bytes to int
-	return result;
+		if (pf.dwFourCC == DDS_FOURCC_DXT1)
+			out->format = dds_format::bc1;
+		else if (pf.dwFourCC == DDS_FOURCC_DXT5)
+			out->format = dds_format::bc3;
+		else
+			found = false;
+	}
+	else if ((pf.dwFlags & DDPF_RGB) && pf.dwRGBBitCount == 32)
+	{
+		//red in the low byte is rgba in memory, in the third byte bgra
+		out->format = pf.dwRBitMask == 0x00ff0000 ? dds_format::bgra8 : dds_format::rgba8;
+	}
+	else
+	{
+		found = false;
+	}
+	if (!found)
+	{
+		LOG_ERROR("Unsupported DDS pixel format, flags:", pf.dwFlags, "fourcc:", pf.dwFourCC);
+		return false;
+	}
+
+	//mips beyond the 1x1 level or a zero count in the header are ignored
+	uint32_t mip_count = (header->Flags & DDSD_MIPMAPCOUNT) && header->MipMapCount > 0 ?
+		header->MipMapCount : 1;
+	uint32_t full_chain = 1;
+	for (uint32_t size = header->Width > header->Height ? header->Width : header->Height;
+		size > 1; size >>= 1)
+		full_chain++;
+	mip_count = mip_count < full_chain ? mip_count : full_chain;
+	mip_count = mip_count < DDS_MAX_MIPS ? mip_count : DDS_MAX_MIPS;
+	bool compressed = out->format != dds_format::rgba8 && out->format != dds_format::bgra8;
+	uint64_t block_bytes = out->format == dds_format::bc1 ? 8 : 16;
+	uint64_t pixel_bytes = 0;
+	for (uint32_t m = 0; m < mip_count; m++)
+	{
+		dds_mip& mip = out->mips[m];
+		mip.width = header->Width >> m ? header->Width >> m : 1;
+		mip.height = header->Height >> m ? header->Height >> m : 1;
+		mip.offset = pixel_bytes;
+		mip.size = compressed ?
+			(uint64_t)((mip.width + 3) / 4) * ((mip.height + 3) / 4) * block_bytes :
+			(uint64_t)mip.width * mip.height * 4;
+		pixel_bytes += mip.size;
+	}
+	if (bytes.size() - header_bytes < pixel_bytes)
+	{
+		LOG_ERROR("DDS pixel data truncated, bytes:", bytes.size() - header_bytes, "expected:", pixel_bytes);
+		return false;
+	}
+	out->header = header;
+	out->width = header->Width;
+	out->height = header->Height;
+	out->mip_count = mip_count;
+	out->pixels = bytes.data() + header_bytes;
+	out->pixel_bytes = pixel_bytes;
+	return true;
 }
 
-auto dazai_engine::resources::load_dds_file(const char* filename)-> DDSFile*
+auto dazai_engine::resources::write_file(const char* filename, const void* data, size_t size)-> bool
 {
-	DDSFile* result = new DDSFile;
-	result = (DDSFile*)read_raw_file(filename);
-	return result;
-}
\ No newline at end of file
+	std::string temp_path = std::string(filename) + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG_ERROR("Failed to open file:", temp_path);
+			return false;
+		}
+		file.write((const char*)data, size);
+		if (!file.good())
+		{
+			LOG_ERROR("Failed to write file:", temp_path);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temp_path, filename, error);
+	if (error)
+	{
+		LOG_ERROR("Failed to replace file:", filename, error.message());
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+	return true;
+}
+
+auto dazai_engine::resources::write_ppm(const char* filename, const uint8_t* rgba,
+	uint32_t width, uint32_t height)-> bool
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Failed to open file:", filename);
+		return false;
+	}
+	file << "P6\n" << width << " " << height << "\n255\n";
+	//one row at a time, rgb only
+	std::vector<char> row(width * 3);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* src = rgba + (size_t)y * width * 4;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = (char)src[x * 4 + 0];
+			row[x * 3 + 1] = (char)src[x * 4 + 1];
+			row[x * 3 + 2] = (char)src[x * 4 + 2];
+		}
+		file.write(row.data(), row.size());
+	}
+	return file.good();
+}
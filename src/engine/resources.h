@@ -2,14 +2,42 @@
 #include <iostream>
 #include <fstream>
 #include<filesystem>
+#include <span>
+#include <vector>
 #include "dds.h"
+#include "mapped_file.h"
 
 namespace dazai_engine
 {
-	static class resources
+	//bytes of one asset, from the mounted pack or a loose file. bytes
+	//points into file, storage or the pack, valid while this is alive
+	struct asset_data
+	{
+		mapped_file file;
+		std::vector<uint8_t> storage;
+		std::span<const uint8_t> bytes;
+	};
+
+	class resources
 	{
 	public:
-		auto static read_raw_file(const char* filename, uint32_t* length = nullptr)-> char*;
-		auto static load_dds_file(const char* filename)->DDSFile*;
+		//maps a file under RESOURCES read only, no copy and no heap buffer
+		auto static map_file(const char* filename, mapped_file* out)->bool;
+		//mounts a pack from tools/asset_packer, load_asset looks there first.
+		//path is used as is. call before anything loads assets
+		auto static mount_pack(const char* path)->bool;
+		//filename relative to RESOURCES, from the pack if it has it,
+		//otherwise mapped from the loose file
+		auto static load_asset(const char* filename, asset_data* out)->bool;
+		//checks magic, header sizes and that the pixel data is all there.
+		//out points into bytes, so bytes has to outlive it
+		auto static parse_dds(std::span<const uint8_t> bytes, dds_texture* out)->bool;
+		//writes a temporary next to filename and renames it over, so a crash
+		//never leaves a half written file. filename is used as is
+		auto static write_file(const char* filename, const void* data, size_t size)->bool;
+		//binary ppm from tightly packed rgba8 pixels, alpha is dropped.
+		//filename is used as is, not relative to RESOURCES
+		auto static write_ppm(const char* filename, const uint8_t* rgba,
+			uint32_t width, uint32_t height)->bool;
 	};
 }
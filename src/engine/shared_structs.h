@@ -13,3 +13,21 @@ struct transform
     float size_x;
     float size_y;
 };
+
+//per step constants of the particle solver, push constants of particles.comp
+struct particle_step_params
+{
+    float screen_width;
+    float screen_height;
+    //dt relative to the rate the per step constants were tuned at
+    float step_scale;
+    float step_damping;
+    float gravity;
+    float particle_radius;
+    float repulsion_distance;
+    float wave_amplitude;
+    float wave_frequency;
+    int particle_count;
+    int grid_width;
+    int grid_height;
+};
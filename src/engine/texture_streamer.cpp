@@ -0,0 +1,360 @@
+#include "texture_streamer.h"
+#include <cstring>
+#include "logger.h"
+#include "profiler.h"
+#include "resources.h"
+
+namespace
+{
+	auto vk_texture_format(const dds_texture& texture) -> VkFormat
+	{
+		switch (texture.format)
+		{
+		case dds_format::bgra8:
+			return texture.srgb ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_B8G8R8A8_UNORM;
+		case dds_format::bc1:
+			//dxt1 may use its 1 bit alpha, the rgba variant keeps it
+			return texture.srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case dds_format::bc3:
+			return texture.srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case dds_format::bc7:
+			return texture.srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default:
+			return texture.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+}
+
+dazai_engine::texture_streamer::~texture_streamer()
+{
+	shutdown();
+}
+
+auto dazai_engine::texture_streamer::init(VkDevice device, VkPhysicalDevice physical_device,
+	gpu_allocator* allocator, uint32_t graphics_family, uint32_t transfer_family,
+	VkQueue transfer_queue, bool texture_compression_bc) -> void
+{
+	m_device = device;
+	m_physical_device = physical_device;
+	m_allocator = allocator;
+	m_graphics_family = graphics_family;
+	m_transfer_queue = transfer_family != graphics_family ? transfer_queue : VK_NULL_HANDLE;
+	m_transfer_family = m_transfer_queue != VK_NULL_HANDLE ? transfer_family : graphics_family;
+	m_texture_compression_bc = texture_compression_bc;
+	m_stop = false;
+	m_io_thread = std::thread(&texture_streamer::io_loop, this);
+}
+
+auto dazai_engine::texture_streamer::shutdown() -> void
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	if (m_io_thread.joinable())
+		m_io_thread.join();
+	//nothing else touches the lists once the io thread is gone
+	for (auto* jobs : { &m_ready, &m_in_flight })
+	{
+		for (auto& job : *jobs)
+		{
+			if (job->submitted)
+				VKCHECK(vkWaitForFences(m_device, 1, &job->fence, VK_TRUE, UINT64_MAX));
+			release(*job);
+			vkDestroyImageView(m_device, job->texture.image.view, 0);
+			vkDestroyImage(m_device, job->texture.image.vk_image, 0);
+			m_allocator->free(&job->texture.image.allocation);
+		}
+		jobs->clear();
+	}
+	m_requests.clear();
+}
+
+auto dazai_engine::texture_streamer::request(const char* path) -> void
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(path);
+		m_pending++;
+	}
+	m_wake.notify_one();
+}
+
+auto dazai_engine::texture_streamer::poll(VkQueue graphics_queue,
+	std::vector<streamed_texture>& done) -> void
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& job : m_ready)
+			m_in_flight.push_back(std::move(job));
+		m_ready.clear();
+	}
+	for (size_t i = 0; i < m_in_flight.size();)
+	{
+		upload& job = *m_in_flight[i];
+		//no transfer family, the copies go in front of the next frame
+		if (!job.submitted)
+		{
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &job.cmd;
+			VKCHECK(vkQueueSubmit(graphics_queue, 1, &submit_info, job.fence));
+			job.submitted = true;
+		}
+		if (vkGetFenceStatus(m_device, job.fence) != VK_SUCCESS)
+		{
+			i++;
+			continue;
+		}
+		release(job);
+		done.push_back(std::move(job.texture));
+		m_in_flight.erase(m_in_flight.begin() + i);
+	}
+}
+
+auto dazai_engine::texture_streamer::flush(VkQueue graphics_queue,
+	std::vector<streamed_texture>& done) -> void
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_pending == 0 || m_stop; });
+	}
+	poll(graphics_queue, done);
+	for (auto& job : m_in_flight)
+		VKCHECK(vkWaitForFences(m_device, 1, &job->fence, VK_TRUE, UINT64_MAX));
+	poll(graphics_queue, done);
+}
+
+auto dazai_engine::texture_streamer::record_acquire(VkCommandBuffer cmd,
+	const streamed_texture& texture) -> void
+{
+	//must match the release barrier recorded on the transfer queue
+	VkImageMemoryBarrier image_barrier{};
+	image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_barrier.image = texture.image.vk_image;
+	image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_barrier.srcAccessMask = 0;
+	image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	image_barrier.srcQueueFamilyIndex = m_transfer_family;
+	image_barrier.dstQueueFamilyIndex = m_graphics_family;
+	image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_barrier.subresourceRange.levelCount = texture.mip_count;
+	image_barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, 0, 0, 0, 1, &image_barrier);
+}
+
+auto dazai_engine::texture_streamer::io_loop() -> void
+{
+	profiler::set_thread_name("texture io");
+	for (;;)
+	{
+		std::string path;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stop || !m_requests.empty(); });
+			if (m_stop)
+				return;
+			path = std::move(m_requests.front());
+			m_requests.erase(m_requests.begin());
+		}
+		std::unique_ptr<upload> job = prepare(path);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (job)
+				m_ready.push_back(std::move(job));
+			m_pending--;
+		}
+		m_idle.notify_all();
+	}
+}
+
+auto dazai_engine::texture_streamer::prepare(const std::string& path) -> std::unique_ptr<upload>
+{
+	PROFILE_ZONE("load texture");
+	asset_data file;
+	dds_texture texture{};
+	if (!resources::load_asset(path.c_str(), &file) ||
+		!resources::parse_dds(file.bytes, &texture))
+	{
+		LOG_ERROR("Texture streaming failed:", path);
+		return nullptr;
+	}
+	//the format can be listed as sampleable while the feature is off,
+	//using it then is still invalid. the placeholder stays in place
+	bool block_compressed = texture.format == dds_format::bc1 ||
+		texture.format == dds_format::bc3 || texture.format == dds_format::bc7;
+	if (block_compressed && !m_texture_compression_bc)
+	{
+		LOG_ERROR("BC texture without textureCompressionBC on the device:", path);
+		return nullptr;
+	}
+	VkFormat format = vk_texture_format(texture);
+	VkFormatProperties format_props{};
+	vkGetPhysicalDeviceFormatProperties(m_physical_device, format, &format_props);
+	if (!(format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		LOG_ERROR("Texture format not supported by the device:", format, path);
+		return nullptr;
+	}
+
+	auto job = std::make_unique<upload>();
+	job->texture.path = path;
+	job->texture.format = format;
+	job->texture.mip_count = texture.mip_count;
+	job->texture.needs_acquire = dedicated_transfer();
+	//IMAGE, exclusive to one family at a time, ownership moves with the barriers
+	image& image = job->texture.image;
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.mipLevels = texture.mip_count;
+	image_info.arrayLayers = 1;
+	image_info.format = format;
+	image_info.extent = { texture.width, texture.height, 1 };
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VKCHECK(vkCreateImage(m_device, &image_info, 0, &image.vk_image));
+	VkMemoryRequirements mem_req{};
+	vkGetImageMemoryRequirements(m_device, image.vk_image, &mem_req);
+	image.allocation = m_allocator->allocate(mem_req, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+	//STAGING, the pixels are copied once, straight from the mapping
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_info.size = texture.pixel_bytes;
+	VKCHECK(vkCreateBuffer(m_device, &buffer_info, 0, &job->staging));
+	vkGetBufferMemoryRequirements(m_device, job->staging, &mem_req);
+	job->staging_allocation = m_allocator->allocate(mem_req,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+	if (image.allocation.memory == VK_NULL_HANDLE || !job->staging_allocation.data)
+	{
+		LOG_ERROR("Out of memory for texture:", path);
+		release(*job);
+		vkDestroyImage(m_device, image.vk_image, 0);
+		m_allocator->free(&image.allocation);
+		return nullptr;
+	}
+	VKCHECK(vkBindImageMemory(m_device, image.vk_image,
+		image.allocation.memory, image.allocation.offset));
+	VKCHECK(vkBindBufferMemory(m_device, job->staging,
+		job->staging_allocation.memory, job->staging_allocation.offset));
+	memcpy(job->staging_allocation.data, texture.pixels, texture.pixel_bytes);
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image.vk_image;
+	view_info.format = format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.layerCount = 1;
+	view_info.subresourceRange.levelCount = texture.mip_count;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	VKCHECK(vkCreateImageView(m_device, &view_info, 0, &image.view));
+
+	//COMMANDS, a pool per upload so recording here never touches a pool
+	//the render thread uses
+	VkCommandPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_info.queueFamilyIndex = m_transfer_family;
+	VKCHECK(vkCreateCommandPool(m_device, &pool_info, 0, &job->command_pool));
+	VkCommandBufferAllocateInfo cmd_alloc{};
+	cmd_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmd_alloc.commandPool = job->command_pool;
+	cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmd_alloc.commandBufferCount = 1;
+	VKCHECK(vkAllocateCommandBuffers(m_device, &cmd_alloc, &job->cmd));
+	record_upload(*job, texture);
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VKCHECK(vkCreateFence(m_device, &fence_info, 0, &job->fence));
+
+	if (dedicated_transfer())
+	{
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &job->cmd;
+		VKCHECK(vkQueueSubmit(m_transfer_queue, 1, &submit_info, job->fence));
+		job->submitted = true;
+	}
+	LOG_INFO("Texture loaded:", path, "mips:", texture.mip_count, "bytes:", texture.pixel_bytes);
+	return job;
+}
+
+auto dazai_engine::texture_streamer::record_upload(upload& job, const dds_texture& texture) -> void
+{
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VKCHECK(vkBeginCommandBuffer(job.cmd, &begin_info));
+
+	VkImageMemoryBarrier image_barrier{};
+	image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_barrier.image = job.texture.image.vk_image;
+	image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	image_barrier.srcAccessMask = 0;
+	image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_barrier.subresourceRange.levelCount = texture.mip_count;
+	image_barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(job.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, 0, 0, 0, 1, &image_barrier);
+
+	//every mip in one copy, they sit back to back in staging like in the file
+	VkBufferImageCopy copy_regions[DDS_MAX_MIPS]{};
+	for (uint32_t m = 0; m < texture.mip_count; m++)
+	{
+		copy_regions[m].bufferOffset = texture.mips[m].offset;
+		copy_regions[m].imageExtent = { texture.mips[m].width, texture.mips[m].height, 1 };
+		copy_regions[m].imageSubresource.mipLevel = m;
+		copy_regions[m].imageSubresource.layerCount = 1;
+		copy_regions[m].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	vkCmdCopyBufferToImage(job.cmd, job.staging, job.texture.image.vk_image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.mip_count, copy_regions);
+
+	image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	if (dedicated_transfer())
+	{
+		//release half of the ownership transfer, the graphics queue
+		//repeats this barrier in record_acquire
+		image_barrier.dstAccessMask = 0;
+		image_barrier.srcQueueFamilyIndex = m_transfer_family;
+		image_barrier.dstQueueFamilyIndex = m_graphics_family;
+		vkCmdPipelineBarrier(job.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, 0, 0, 0, 1, &image_barrier);
+	}
+	else
+	{
+		image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(job.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, 0, 0, 0, 1, &image_barrier);
+	}
+	VKCHECK(vkEndCommandBuffer(job.cmd));
+}
+
+auto dazai_engine::texture_streamer::release(upload& job) -> void
+{
+	vkDestroyFence(m_device, job.fence, 0);
+	//frees job.cmd with it
+	vkDestroyCommandPool(m_device, job.command_pool, 0);
+	vkDestroyBuffer(m_device, job.staging, 0);
+	m_allocator->free(&job.staging_allocation);
+	job.fence = VK_NULL_HANDLE;
+	job.command_pool = VK_NULL_HANDLE;
+	job.cmd = VK_NULL_HANDLE;
+	job.staging = VK_NULL_HANDLE;
+}
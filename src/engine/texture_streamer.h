@@ -0,0 +1,103 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dds.h"
+#include "vk_types.h"
+
+namespace dazai_engine
+{
+	//a texture that finished uploading, owned by whoever polled it
+	struct streamed_texture
+	{
+		std::string path;
+		dazai_engine::image image;
+		VkFormat format;
+		uint32_t mip_count;
+		//copied on the transfer family, the graphics queue has to take
+		//ownership with record_acquire before sampling it
+		bool needs_acquire;
+	};
+
+	//loads dds files on a background io thread and uploads them without
+	//blocking the render thread. the io thread maps and parses the file,
+	//fills a staging buffer and records the copies. with a dedicated
+	//transfer family it also submits them there and releases the image to
+	//the graphics family, otherwise poll() submits them on the graphics
+	//queue. completion is checked with fences, never waited on
+	class texture_streamer
+	{
+	public:
+		texture_streamer() = default;
+		~texture_streamer();
+		texture_streamer(const texture_streamer&) = delete;
+		auto operator=(const texture_streamer&) -> texture_streamer& = delete;
+
+		//transfer_queue may be null, uploads then go through the graphics
+		//family and poll()'s queue. bc textures are only accepted when the
+		//device was created with textureCompressionBC
+		auto init(VkDevice device, VkPhysicalDevice physical_device, gpu_allocator* allocator,
+			uint32_t graphics_family, uint32_t transfer_family, VkQueue transfer_queue,
+			bool texture_compression_bc) -> void;
+		//stops the io thread, waits for submitted uploads and frees
+		//everything that was never handed out
+		auto shutdown() -> void;
+		//path is relative to RESOURCES like resources::load_asset
+		auto request(const char* path) -> void;
+		//render thread only. submits uploads waiting for graphics_queue and
+		//moves the ones whose fence signalled into done
+		auto poll(VkQueue graphics_queue, std::vector<streamed_texture>& done) -> void;
+		//poll that blocks until every request so far is loaded, for frame captures
+		auto flush(VkQueue graphics_queue, std::vector<streamed_texture>& done) -> void;
+		//second half of the ownership transfer, record before the first use
+		auto record_acquire(VkCommandBuffer cmd, const streamed_texture& texture) -> void;
+		auto dedicated_transfer() const -> bool { return m_transfer_queue != VK_NULL_HANDLE; }
+
+	private:
+		struct upload
+		{
+			streamed_texture texture;
+			VkBuffer staging{ VK_NULL_HANDLE };
+			gpu_allocation staging_allocation;
+			VkCommandPool command_pool{ VK_NULL_HANDLE };
+			VkCommandBuffer cmd{ VK_NULL_HANDLE };
+			VkFence fence{ VK_NULL_HANDLE };
+			bool submitted{ false };
+		};
+
+		auto io_loop() -> void;
+		//file to recorded command buffer, null if anything fails
+		auto prepare(const std::string& path) -> std::unique_ptr<upload>;
+		auto record_upload(upload& job, const dds_texture& texture) -> void;
+		//frees everything but the image, that one is handed out
+		auto release(upload& job) -> void;
+
+		VkDevice m_device{ VK_NULL_HANDLE };
+		VkPhysicalDevice m_physical_device{ VK_NULL_HANDLE };
+		gpu_allocator* m_allocator{ nullptr };
+		uint32_t m_graphics_family{ 0 };
+		//same as m_graphics_family without a dedicated transfer family
+		uint32_t m_transfer_family{ 0 };
+		//only the io thread submits here
+		VkQueue m_transfer_queue{ VK_NULL_HANDLE };
+		bool m_texture_compression_bc{ false };
+
+		std::thread m_io_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		//signalled whenever the io thread finishes a request
+		std::condition_variable m_idle;
+		bool m_stop{ false };
+		//requested but not yet in m_ready or failed
+		uint32_t m_pending{ 0 };
+		std::vector<std::string> m_requests;
+		//recorded by the io thread, picked up by poll
+		std::vector<std::unique_ptr<upload>> m_ready;
+		//render thread only
+		std::vector<std::unique_ptr<upload>> m_in_flight;
+	};
+}
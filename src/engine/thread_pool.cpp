@@ -0,0 +1,88 @@
+#include "thread_pool.h"
+#include "profiler.h"
+
+dazai_engine::thread_pool::thread_pool(uint32_t worker_count)
+{
+	if (worker_count == 0)
+	{
+		uint32_t hw = std::thread::hardware_concurrency();
+		worker_count = hw > 1 ? hw - 1 : 0;
+	}
+	m_workers.reserve(worker_count);
+	for (uint32_t i = 0; i < worker_count; ++i)
+		m_workers.emplace_back(&thread_pool::worker_loop, this);
+}
+
+dazai_engine::thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+auto dazai_engine::thread_pool::worker_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(m_workers.size());
+}
+
+auto dazai_engine::thread_pool::dispatch(job_fn job, void* ctx, uint32_t count, uint32_t chunk_size) -> void
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = job;
+		m_job_ctx = ctx;
+		m_job_count = count;
+		m_job_chunk_size = chunk_size > 0 ? chunk_size : 1;
+		m_next_chunk.store(0, std::memory_order_relaxed);
+		m_busy_workers = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+	m_wake.notify_all();
+	//calling thread works too instead of just waiting
+	run_chunks();
+	//ctx lives on the caller's stack, every worker has to be out of the job
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busy_workers == 0; });
+	m_job = nullptr;
+	m_job_ctx = nullptr;
+}
+
+auto dazai_engine::thread_pool::run_chunks() -> void
+{
+	uint32_t chunk_count = (m_job_count + m_job_chunk_size - 1) / m_job_chunk_size;
+	for (;;)
+	{
+		uint32_t chunk = m_next_chunk.fetch_add(1, std::memory_order_relaxed);
+		if (chunk >= chunk_count)
+			break;
+		uint32_t begin = chunk * m_job_chunk_size;
+		uint32_t end = begin + m_job_chunk_size < m_job_count ? begin + m_job_chunk_size : m_job_count;
+		m_job(m_job_ctx, begin, end);
+	}
+}
+
+auto dazai_engine::thread_pool::worker_loop() -> void
+{
+	profiler::set_thread_name("worker");
+	uint64_t seen_generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stop || m_generation != seen_generation; });
+			if (m_stop)
+				return;
+			seen_generation = m_generation;
+		}
+		run_chunks();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busy_workers;
+		}
+		m_done.notify_one();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dazai_engine
+{
+	//persistent worker threads for data parallel loops. workers are created
+	//once and sleep between jobs, the calling thread also takes chunks so a
+	//pool of n workers runs a job on n + 1 threads
+	class thread_pool
+	{
+	public:
+		//0 = one worker per hardware thread minus the calling thread
+		thread_pool(uint32_t worker_count = 0);
+		~thread_pool();
+		auto worker_count() const -> uint32_t;
+
+		//runs fn(begin, end) over [0, count) in chunks of chunk_size and
+		//blocks until every chunk is done. chunks are handed out dynamically
+		//so fn must not depend on which thread or order it runs in
+		template<typename Fn>
+		auto parallel_for(uint32_t count, uint32_t chunk_size, Fn&& fn) -> void
+		{
+			if (count == 0)
+				return;
+			if (m_workers.empty() || count <= chunk_size)
+			{
+				fn(0u, count);
+				return;
+			}
+			auto job = [](void* ctx, uint32_t begin, uint32_t end)
+			{
+				(*static_cast<std::remove_reference_t<Fn>*>(ctx))(begin, end);
+			};
+			dispatch(job, &fn, count, chunk_size);
+		}
+
+	private:
+		using job_fn = void(*)(void* ctx, uint32_t begin, uint32_t end);
+
+		auto dispatch(job_fn job, void* ctx, uint32_t count, uint32_t chunk_size) -> void;
+		auto run_chunks() -> void;
+		auto worker_loop() -> void;
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		//bumped for every job so sleeping workers know there is new work
+		uint64_t m_generation{ 0 };
+		bool m_stop{ false };
+		//workers that haven't finished the current job yet
+		uint32_t m_busy_workers{ 0 };
+
+		//current job, only valid while a dispatch is in flight
+		job_fn m_job{ nullptr };
+		void* m_job_ctx{ nullptr };
+		uint32_t m_job_count{ 0 };
+		uint32_t m_job_chunk_size{ 1 };
+		std::atomic<uint32_t> m_next_chunk{ 0 };
+	};
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace dazai_engine
+{
+	//single producer / single consumer handoff of whole values. the producer
+	//fills write_buffer() and publishes it, the consumer picks up the newest
+	//published value with consume() and reads it through read_buffer().
+	//neither side ever waits and neither ever sees a buffer the other one is
+	//still touching, older unread values are simply overwritten
+	template<typename T>
+	class triple_buffer
+	{
+	public:
+		//producer side, private until publish()
+		auto write_buffer() -> T&
+		{
+			return m_buffers[m_back];
+		}
+
+		//hands the write buffer to the consumer and takes the spare one back
+		auto publish() -> void
+		{
+			uint8_t old = m_middle.exchange(m_back | NEW_BIT, std::memory_order_acq_rel);
+			m_back = old & INDEX_MASK;
+		}
+
+		//consumer side, swaps in the newest published buffer.
+		//returns false if nothing was published since the last call
+		auto consume() -> bool
+		{
+			if ((m_middle.load(std::memory_order_relaxed) & NEW_BIT) == 0)
+				return false;
+			uint8_t old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+			m_front = old & INDEX_MASK;
+			return true;
+		}
+
+		//consumer side, stays valid and unchanged until the next consume()
+		auto read_buffer() -> T&
+		{
+			return m_buffers[m_front];
+		}
+
+	private:
+		static constexpr uint8_t INDEX_MASK = 0x3;
+		static constexpr uint8_t NEW_BIT = 0x4;
+
+		//value initialised so the consumer never reads garbage before the first publish
+		T m_buffers[3]{};
+		//only touched by the producer
+		uint8_t m_back{ 0 };
+		//spare buffer index plus NEW_BIT while it holds an unread value
+		std::atomic<uint8_t> m_middle{ 1 };
+		//only touched by the consumer
+		uint8_t m_front{ 2 };
+	};
+}
@@ -1,19 +1,20 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include "gpu_allocator.h"
 
 namespace dazai_engine
 {
 	struct image
 	{
 		VkImage vk_image;
-		VkDeviceMemory memory;
+		gpu_allocation allocation;
 		VkImageView view;
 	};
 
 	struct buffer
 	{
 		VkBuffer vk_buffer;
-		VkDeviceMemory memory;
+		gpu_allocation allocation;
 		uint32_t size;
 		void* data;
 	};
@@ -1,14 +1,99 @@
 ﻿// Dazai Vulkan.cpp : Defines the entry point for the application.
 #include <iostream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include "engine/engine.h"
 #include "engine/logger.h"
+#include "engine/resources.h"
 
 using namespace std;
 using namespace dazai_engine;
 logger g_logger;
-int main()
+//--headless [frames] renders offscreen without a window,
+//--capture <file.ppm> writes the last headless frame to disk,
+//--sim-hz <rate> sets the fixed simulation rate,
+//--capacity <n> sizes the initial entity storage, it still grows on demand,
+//--gpu-sim steps the particles in a compute shader,
+//--gpu-sim-check also compares the first gpu step against the cpu solver and exits 1 on a mismatch,
+//--log-level <info|warning|error> hides records below that level,
+//--binary-log <file> writes compact binary records, see tools/log_decoder,
+//--profile prints per zone cpu timings, --trace <file.json> writes a chrome trace on exit,
+//--pack <file.pak> loads assets from a pack built by tools/asset_packer,
+//--pipeline-cache <file> keeps the driver's pipeline cache there, --no-pipeline-cache disables it
+int main(int argc, char** argv)
 {
-	engine d_engine;
-	d_engine.update();
-	return 0;
+	engine_config config{};
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			config.headless = true;
+			if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+				config.headless_frames = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			config.capture_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc)
+		{
+			config.sim_rate_hz = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+		{
+			config.entity_capacity = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+		{
+			const char* level = argv[++i];
+			if (strcmp(level, "warning") == 0)
+				g_logger.set_level(LogLevel::warning);
+			else if (strcmp(level, "error") == 0)
+				g_logger.set_level(LogLevel::error);
+			else
+				g_logger.set_level(LogLevel::info);
+		}
+		else if (strcmp(argv[i], "--binary-log") == 0 && i + 1 < argc)
+		{
+			const char* path = argv[++i];
+			if (!g_logger.open_binary(path))
+				LOG_ERROR("Failed to open binary log:", path);
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			config.profile = true;
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			config.trace_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+		{
+			//missing assets still fall back to the loose files
+			const char* path = argv[++i];
+			if (!resources::mount_pack(path))
+				LOG_ERROR("Failed to mount asset pack:", path);
+		}
+		else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+		{
+			config.pipeline_cache_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-pipeline-cache") == 0)
+		{
+			config.pipeline_cache_path = nullptr;
+		}
+		else if (strcmp(argv[i], "--gpu-sim") == 0)
+		{
+			config.gpu_simulation = true;
+		}
+		else if (strcmp(argv[i], "--gpu-sim-check") == 0)
+		{
+			config.gpu_simulation = true;
+			config.gpu_cross_check = true;
+		}
+	}
+	engine d_engine(config);
+	//non zero when --gpu-sim-check finds the solvers apart
+	return d_engine.update() ? 0 : 1;
 }
@@ -0,0 +1,234 @@
+#include "force_kernels.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FORCE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define FORCE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+//msvc emits any intrinsic without flags, gcc/clang need the
+//target enabled per function so the rest of the file stays baseline
+#if defined(FORCE_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	auto repulsion_scalar(float x, float y,
+		const float* xs, const float* ys, uint32_t count,
+		float radius, float* fx, float* fy) -> void
+	{
+		float inv_radius = 1.0f / radius;
+		float acc_x = 0.0f;
+		float acc_y = 0.0f;
+		for (uint32_t j = 0; j < count; ++j)
+		{
+			float dx = xs[j] - x;
+			float dy = ys[j] - y;
+			float distance = std::sqrt(dx * dx + dy * dy);
+			//select instead of branch, compiles to a mask/cmov
+			float factor = distance < radius ? 1.0f - distance * inv_radius : 0.0f;
+			acc_x -= factor * dx;
+			acc_y -= factor * dy;
+		}
+		*fx += acc_x;
+		*fy += acc_y;
+	}
+
+#if defined(FORCE_KERNELS_X86)
+	TARGET_SSE2 auto repulsion_sse(float x, float y,
+		const float* xs, const float* ys, uint32_t count,
+		float radius, float* fx, float* fy) -> void
+	{
+		__m128 px = _mm_set1_ps(x);
+		__m128 py = _mm_set1_ps(y);
+		__m128 r = _mm_set1_ps(radius);
+		__m128 inv_r = _mm_set1_ps(1.0f / radius);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 acc_x = _mm_setzero_ps();
+		__m128 acc_y = _mm_setzero_ps();
+		uint32_t j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + j), px);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + j), py);
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			__m128 mask = _mm_cmplt_ps(distance, r);
+			__m128 factor = _mm_and_ps(mask, _mm_sub_ps(one, _mm_mul_ps(distance, inv_r)));
+			acc_x = _mm_sub_ps(acc_x, _mm_mul_ps(factor, dx));
+			acc_y = _mm_sub_ps(acc_y, _mm_mul_ps(factor, dy));
+		}
+		alignas(16) float lanes_x[4];
+		alignas(16) float lanes_y[4];
+		_mm_store_ps(lanes_x, acc_x);
+		_mm_store_ps(lanes_y, acc_y);
+		*fx += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+		*fy += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+		//leftover neighbours
+		repulsion_scalar(x, y, xs + j, ys + j, count - j, radius, fx, fy);
+	}
+
+	TARGET_AVX2 auto repulsion_avx2(float x, float y,
+		const float* xs, const float* ys, uint32_t count,
+		float radius, float* fx, float* fy) -> void
+	{
+		__m256 px = _mm256_set1_ps(x);
+		__m256 py = _mm256_set1_ps(y);
+		__m256 r = _mm256_set1_ps(radius);
+		__m256 inv_r = _mm256_set1_ps(1.0f / radius);
+		__m256 one = _mm256_set1_ps(1.0f);
+		__m256 acc_x = _mm256_setzero_ps();
+		__m256 acc_y = _mm256_setzero_ps();
+		uint32_t j = 0;
+		for (; j + 8 <= count; j += 8)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + j), px);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + j), py);
+			__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+			__m256 mask = _mm256_cmp_ps(distance, r, _CMP_LT_OQ);
+			__m256 factor = _mm256_and_ps(mask, _mm256_sub_ps(one, _mm256_mul_ps(distance, inv_r)));
+			acc_x = _mm256_sub_ps(acc_x, _mm256_mul_ps(factor, dx));
+			acc_y = _mm256_sub_ps(acc_y, _mm256_mul_ps(factor, dy));
+		}
+		alignas(32) float lanes_x[8];
+		alignas(32) float lanes_y[8];
+		_mm256_store_ps(lanes_x, acc_x);
+		_mm256_store_ps(lanes_y, acc_y);
+		float sum_x = 0.0f;
+		float sum_y = 0.0f;
+		for (int k = 0; k < 8; ++k)
+		{
+			sum_x += lanes_x[k];
+			sum_y += lanes_y[k];
+		}
+		*fx += sum_x;
+		*fy += sum_y;
+		repulsion_scalar(x, y, xs + j, ys + j, count - j, radius, fx, fy);
+	}
+
+	auto cpu_has_sse2() -> bool
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true; // part of the x64 baseline
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	auto cpu_has_avx2() -> bool
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		//avx needs the os to save ymm registers, check osxsave + xcr0
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+#if defined(FORCE_KERNELS_NEON)
+	auto repulsion_neon(float x, float y,
+		const float* xs, const float* ys, uint32_t count,
+		float radius, float* fx, float* fy) -> void
+	{
+		float32x4_t px = vdupq_n_f32(x);
+		float32x4_t py = vdupq_n_f32(y);
+		float32x4_t r = vdupq_n_f32(radius);
+		float32x4_t inv_r = vdupq_n_f32(1.0f / radius);
+		float32x4_t one = vdupq_n_f32(1.0f);
+		float32x4_t acc_x = vdupq_n_f32(0.0f);
+		float32x4_t acc_y = vdupq_n_f32(0.0f);
+		uint32_t j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			float32x4_t dx = vsubq_f32(vld1q_f32(xs + j), px);
+			float32x4_t dy = vsubq_f32(vld1q_f32(ys + j), py);
+			float32x4_t distance = vsqrtq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)));
+			uint32x4_t mask = vcltq_f32(distance, r);
+			float32x4_t factor = vreinterpretq_f32_u32(vandq_u32(mask,
+				vreinterpretq_u32_f32(vsubq_f32(one, vmulq_f32(distance, inv_r)))));
+			acc_x = vsubq_f32(acc_x, vmulq_f32(factor, dx));
+			acc_y = vsubq_f32(acc_y, vmulq_f32(factor, dy));
+		}
+		*fx += vaddvq_f32(acc_x);
+		*fy += vaddvq_f32(acc_y);
+		repulsion_scalar(x, y, xs + j, ys + j, count - j, radius, fx, fy);
+	}
+#endif
+}
+
+auto detect_force_kernel() -> force_kernel_type
+{
+#if defined(FORCE_KERNELS_X86)
+	if (cpu_has_avx2())
+		return force_kernel_type::avx2;
+	if (cpu_has_sse2())
+		return force_kernel_type::sse;
+#elif defined(FORCE_KERNELS_NEON)
+	return force_kernel_type::neon;
+#endif
+	return force_kernel_type::scalar;
+}
+
+auto get_force_kernel(force_kernel_type type) -> force_kernel_fn
+{
+	switch (type)
+	{
+	case force_kernel_type::scalar:
+		return repulsion_scalar;
+#if defined(FORCE_KERNELS_X86)
+	case force_kernel_type::sse:
+		return cpu_has_sse2() ? repulsion_sse : nullptr;
+	case force_kernel_type::avx2:
+		return cpu_has_avx2() ? repulsion_avx2 : nullptr;
+#endif
+#if defined(FORCE_KERNELS_NEON)
+	case force_kernel_type::neon:
+		return repulsion_neon;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+auto force_kernel_name(force_kernel_type type) -> const char*
+{
+	switch (type)
+	{
+	case force_kernel_type::scalar:
+		return "scalar";
+	case force_kernel_type::sse:
+		return "sse";
+	case force_kernel_type::avx2:
+		return "avx2";
+	case force_kernel_type::neon:
+		return "neon";
+	}
+	return "unknown";
+}
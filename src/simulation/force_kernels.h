@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+//repulsion kernels for the particle solver. every variant accumulates
+//   f -= (1 - |d| / radius) * d   for every neighbour with |d| < radius
+//into fx/fy, where d is neighbour - (x, y). the in-range test is a mask,
+//not a branch, so neighbours outside the radius just add zero.
+//the scalar kernel is the reference the vector ones are checked against
+enum class force_kernel_type
+{
+	scalar,
+	sse,
+	avx2,
+	neon
+};
+
+using force_kernel_fn = void(*)(float x, float y,
+	const float* xs, const float* ys, uint32_t count,
+	float radius, float* fx, float* fy);
+
+//best kernel the cpu we are running on supports
+auto detect_force_kernel() -> force_kernel_type;
+//returns nullptr if the variant was not compiled in for this architecture
+//or the cpu doesn't support it
+auto get_force_kernel(force_kernel_type type) -> force_kernel_fn;
+auto force_kernel_name(force_kernel_type type) -> const char*;
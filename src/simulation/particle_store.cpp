@@ -0,0 +1,94 @@
+#include "particle_store.h"
+#include "../engine/shared_structs.h"
+#include <cstring>
+#include <new>
+
+namespace
+{
+	auto alloc_array(uint32_t capacity) -> float*
+	{
+		return static_cast<float*>(::operator new[](sizeof(float) * capacity,
+			std::align_val_t(PARTICLE_ALIGNMENT), std::nothrow));
+	}
+
+	auto free_array(float* array) -> void
+	{
+		::operator delete[](array, std::align_val_t(PARTICLE_ALIGNMENT));
+	}
+}
+
+particle_store::~particle_store()
+{
+	free_array(x);
+	free_array(y);
+	free_array(prev_x);
+	free_array(prev_y);
+	free_array(vx);
+	free_array(vy);
+	free_array(size);
+}
+
+auto particle_store::reserve(uint32_t new_capacity, uint32_t count) -> bool
+{
+	constexpr uint32_t floats_per_line = PARTICLE_ALIGNMENT / sizeof(float);
+	new_capacity = (new_capacity + floats_per_line - 1) / floats_per_line * floats_per_line;
+	if (new_capacity <= capacity)
+		return true;
+
+	float** arrays[] = { &x, &y, &prev_x, &prev_y, &vx, &vy, &size };
+	constexpr int array_count = sizeof(arrays) / sizeof(arrays[0]);
+	float* grown[array_count]{};
+	for (int a = 0; a < array_count; ++a)
+	{
+		grown[a] = alloc_array(new_capacity);
+		if (grown[a] == nullptr)
+		{
+			for (int b = 0; b < a; ++b)
+				free_array(grown[b]);
+			return false;
+		}
+	}
+	for (int a = 0; a < array_count; ++a)
+	{
+		if (count > 0)
+			memcpy(grown[a], *arrays[a], sizeof(float) * count);
+		//keep the padding deterministic for vector loads
+		memset(grown[a] + count, 0, sizeof(float) * (new_capacity - count));
+		free_array(*arrays[a]);
+		*arrays[a] = grown[a];
+	}
+	capacity = new_capacity;
+	return true;
+}
+
+auto particle_store::copy_render_data(const particle_store& other, uint32_t count) -> bool
+{
+	//old contents don't matter, they are all overwritten
+	if (count > capacity && !reserve(count, 0))
+		return false;
+	if (count == 0)
+		return true;
+	memcpy(x, other.x, sizeof(float) * count);
+	memcpy(y, other.y, sizeof(float) * count);
+	memcpy(prev_x, other.prev_x, sizeof(float) * count);
+	memcpy(prev_y, other.prev_y, sizeof(float) * count);
+	memcpy(size, other.size, sizeof(float) * count);
+	return true;
+}
+
+auto particle_store::pack_transforms(transform* out, uint32_t count, float alpha) const -> void
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		out[i].x = prev_x[i] + (x[i] - prev_x[i]) * alpha;
+		out[i].y = prev_y[i] + (y[i] - prev_y[i]) * alpha;
+		out[i].size_x = size[i];
+		out[i].size_y = size[i];
+	}
+}
+
+auto particle_store::memory_bytes() const -> uint64_t
+{
+	//x, y, prev_x, prev_y, vx, vy, size
+	return (uint64_t)sizeof(float) * capacity * 7;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+//gpu layout from shared_structs.h, that header has no include guard
+//because the shaders include it too
+struct transform;
+
+uint32_t constexpr DEFAULT_ENTITY_CAPACITY = 1000;
+//arrays are padded to a whole number of cache lines so vector
+//loads past the last particle stay inside the allocation
+uint32_t constexpr PARTICLE_ALIGNMENT = 64;
+
+//structure of arrays particle storage the solver runs on,
+//the gpu transform layout is only produced at upload time by pack_transforms
+struct particle_store
+{
+	particle_store() = default;
+	~particle_store();
+	particle_store(const particle_store&) = delete;
+	auto operator=(const particle_store&) -> particle_store& = delete;
+
+	float* x{ nullptr };
+	float* y{ nullptr };
+	//positions before the last step, render interpolates from these
+	float* prev_x{ nullptr };
+	float* prev_y{ nullptr };
+	//displacement applied by the last step
+	float* vx{ nullptr };
+	float* vy{ nullptr };
+	//particles are square sprites, size is used for both axes
+	float* size{ nullptr };
+	uint32_t capacity{ 0 };
+
+	//grows every array to at least new_capacity keeping the first count
+	//particles, never shrinks. returns false if the allocation failed
+	auto reserve(uint32_t new_capacity, uint32_t count) -> bool;
+	//copies what rendering needs (positions, previous positions, size) of
+	//the first count particles from other, grows if needed
+	auto copy_render_data(const particle_store& other, uint32_t count) -> bool;
+	//writes count transforms into out, out is usually mapped gpu memory.
+	//alpha blends from the previous to the current position, 1 = current
+	auto pack_transforms(transform* out, uint32_t count, float alpha = 1.0f) const -> void;
+	//bytes held by all arrays
+	auto memory_bytes() const -> uint64_t;
+};
@@ -1,5 +1,6 @@
 #include "simulation.h"
 #include "../engine/logger.h"
+#include "../engine/profiler.h"
 #include <random>
 #include <cmath>
 #include <chrono>
@@ -12,6 +13,7 @@ constexpr float GRAVITY = 9.8f; // Example gravity value
 constexpr float DAMPING = 0.99f; // Example damping factor for air resistance
 constexpr float COHESION_DISTANCE = 2.0f; // Example cohesion distance
 constexpr float REPULSION_DISTANCE = 20.0f; // Example repulsion distance
+constexpr uint32_t FORCE_CHUNK_SIZE = 256; // Particles per parallel_for chunk
 float WAVE_AMPLITUDE = 0.3f; // Amplitude of the wave
 float WAVE_FREQUENCY = 0.001f; // Frequency of the wave
 
@@ -25,12 +27,13 @@ namespace
     int m_totalTransitionSteps = 0;
 }
 
-bool isSpacePressed(GLFWwindow* window)
+void simulation::handleMouseClick(double xpos, double ypos)
 {
-    return glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    m_pending_clicks.emplace_back(xpos, ypos);
 }
 
-void simulation::handleMouseClick(double xpos, double ypos)
+auto simulation::spawn_at(double xpos, double ypos) -> void
 {
     transform newTransform;
     newTransform.x = static_cast<float>(xpos);
@@ -39,13 +42,14 @@ void simulation::handleMouseClick(double xpos, double ypos)
     newTransform.size_y = 30; // Adjusted size
 
     // Adjust y position to be above the highest particle beneath it
-    for (int i = 0; i < m_state->entity_count; ++i)
+    particle_store& p = m_state->particles;
+    for (uint32_t i = 0; i < m_state->entity_count; ++i)
     {
-        if (m_state->entities[i].transform.x == newTransform.x)
+        if (p.x[i] == newTransform.x)
         {
-            if (m_state->entities[i].transform.y > newTransform.y)
+            if (p.y[i] > newTransform.y)
             {
-                newTransform.y = m_state->entities[i].transform.y + PARTICLE_RADIUS * 2.0f; // Ensure it's above the highest particle
+                newTransform.y = p.y[i] + PARTICLE_RADIUS * 2.0f; // Ensure it's above the highest particle
             }
         }
     }
@@ -53,12 +57,18 @@ void simulation::handleMouseClick(double xpos, double ypos)
     create_entity(newTransform);
 }
 
-simulation::simulation(simulation_state* state, GLFWwindow* window) : m_state(state), m_window(window)
+simulation::simulation(simulation_state* state, GLFWwindow* window, dazai_engine::thread_pool* workers,
+    uint32_t initial_capacity) :
+    m_state(state), m_window(window), m_workers(workers)
 {
+    set_force_kernel(detect_force_kernel());
+    if (!m_state->particles.reserve(initial_capacity, m_state->entity_count))
+        LOG_ERROR("Failed to allocate entity storage, capacity:", initial_capacity);
+
     std::uniform_real_distribution<float> width_dist(PARTICLE_RADIUS, SCREEN_WIDTH - PARTICLE_RADIUS);
     std::uniform_real_distribution<float> height_dist(PARTICLE_RADIUS, SCREEN_HEIGHT / 2); // Limit particles to top half of the screen
 
-    for (int i = 0; i < MAX_ENTITIES / 2; ++i)
+    for (uint32_t i = 0; i < initial_capacity / 2; ++i)
     {
         // Generate random coordinates within the top half of the screen
         float x = width_dist(m_random_engine);
@@ -75,6 +85,9 @@ simulation::simulation(simulation_state* state, GLFWwindow* window) : m_state(st
         create_entity(entityTransform);
     }
 
+    // Headless runs have no window and no input
+    if (!window)
+        return;
     glfwSetWindowUserPointer(window, this);
     glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int mods)
         {
@@ -86,83 +99,144 @@ simulation::simulation(simulation_state* state, GLFWwindow* window) : m_state(st
                 sim->handleMouseClick(xpos, ypos);
             }
         });
+    // glfwGetKey is main thread only, track the key from its callback instead
+    glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode, int action, int mods)
+        {
+            if (key == GLFW_KEY_SPACE && action != GLFW_REPEAT)
+            {
+                simulation* sim = static_cast<simulation*>(glfwGetWindowUserPointer(window));
+                sim->m_space_pressed.store(action == GLFW_PRESS, std::memory_order_relaxed);
+            }
+        });
 }
 
 simulation::~simulation() {}
 
-auto simulation::create_entity(transform transform) -> entity*
+auto simulation::create_entity(transform transform) -> uint32_t
 {
-    entity* e = nullptr;
-    if (m_state->entity_count < MAX_ENTITIES)
+    uint32_t e = INVALID_ENTITY;
+    particle_store& p = m_state->particles;
+    // Grow geometrically so spawning stays amortised O(1)
+    if (m_state->entity_count == p.capacity)
     {
-        e = &m_state->entities[m_state->entity_count++];
-        e->transform = transform;
+        uint32_t new_capacity = p.capacity > 0 ? p.capacity * 2 : DEFAULT_ENTITY_CAPACITY;
+        if (new_capacity <= p.capacity || !p.reserve(new_capacity, m_state->entity_count))
+        {
+            LOG_ERROR("Failed to grow entity storage, capacity:", p.capacity);
+            return e;
+        }
     }
-    else
-        LOG_ERROR("Entities limit reached");
+    e = m_state->entity_count++;
+    p.x[e] = transform.x;
+    p.y[e] = transform.y;
+    p.prev_x[e] = transform.x;
+    p.prev_y[e] = transform.y;
+    p.vx[e] = 0.0f;
+    p.vy[e] = 0.0f;
+    p.size[e] = transform.size_x;
 
     return e;
 }
 
-auto simulation::update() -> void
+auto simulation::set_force_kernel(force_kernel_type type) -> bool
 {
-    bool spacePressed = isSpacePressed(m_window);
-    if (spacePressed)
+    force_kernel_fn kernel = get_force_kernel(type);
+    if (kernel == nullptr)
     {
-        SCREEN_WIDTH = 500;
-        SCREEN_HEIGHT = 720;
+        LOG_WARNING("Force kernel not supported on this cpu:", force_kernel_name(type));
+        return false;
     }
+    m_force_kernel = kernel;
+    LOG_INFO("Force kernel:", force_kernel_name(type));
+    return true;
+}
+
+// The solve pass in particles.comp mirrors this, keep the two in sync
+auto simulation::step_range(uint32_t begin, uint32_t end) -> void
+{
+    particle_store& p = m_state->particles;
+    float* px = p.x;
+    float* py = p.y;
+
     // Apply gravity and forces, and update entity positions
-    for (int i = 0; i < m_state->entity_count; ++i)
+    for (uint32_t i = begin; i < end; ++i)
     {
+        // Keep the start of step position for render interpolation
+        p.prev_x[i] = px[i];
+        p.prev_y[i] = py[i];
+
         // Apply gravity
-        m_state->entities[i].transform.y += GRAVITY;
+        py[i] += GRAVITY * m_step_scale;
 
         // Apply damping (air resistance)
-        m_state->entities[i].transform.y *= DAMPING;
+        py[i] *= m_step_damping;
 
         // Calculate repulsion forces from neighboring particles
         float repulsion_force_x = 0.0f;
         float repulsion_force_y = 0.0f;
-        for (int j = 0; j < m_state->entity_count; ++j)
-        {
-            if (i != j)
+        // Only entities in the surrounding grid cells can be within repulsion distance.
+        // The grid holds the entity's start of step position, which gravity has
+        // already moved away from, so its own slot has to be skipped
+        m_grid.for_each_neighbour_span(px[i], py[i], i,
+            [&](const float* xs, const float* ys, uint32_t count)
             {
-                // Calculate distance between entities
-                float dx = m_state->entities[j].transform.x - m_state->entities[i].transform.x;
-                float dy = m_state->entities[j].transform.y - m_state->entities[i].transform.y;
-                float distance = std::sqrt(dx * dx + dy * dy);
-
-                // Apply repulsion force if particles are within repulsion distance
-                if (distance < REPULSION_DISTANCE)
-                {
-                    float factor = 1.0f - (distance / REPULSION_DISTANCE);
-                    repulsion_force_x -= factor * dx;
-                    repulsion_force_y -= factor * dy;
-                }
-            }
-        }
+                m_force_kernel(px[i], py[i], xs, ys, count, REPULSION_DISTANCE,
+                    &repulsion_force_x, &repulsion_force_y);
+            });
 
         // Apply repulsion force to adjust particle position
-        m_state->entities[i].transform.x += repulsion_force_x;
-        m_state->entities[i].transform.y += repulsion_force_y;
+        repulsion_force_x *= m_step_scale;
+        repulsion_force_y *= m_step_scale;
+        px[i] += repulsion_force_x;
+        py[i] += repulsion_force_y;
 
         // Reflective boundary conditions
-        if (m_state->entities[i].transform.x < PARTICLE_RADIUS -10 || m_state->entities[i].transform.x > SCREEN_WIDTH - PARTICLE_RADIUS)
-            m_state->entities[i].transform.x -= 2 * repulsion_force_x; // Reverse the x-component of the repulsion force
+        if (px[i] < PARTICLE_RADIUS -10 || px[i] > SCREEN_WIDTH - PARTICLE_RADIUS)
+        {
+            px[i] -= 2 * repulsion_force_x; // Reverse the x-component of the repulsion force
+            repulsion_force_x = -repulsion_force_x;
+        }
 
-        if (m_state->entities[i].transform.y < PARTICLE_RADIUS || m_state->entities[i].transform.y > SCREEN_HEIGHT - PARTICLE_RADIUS)
-            m_state->entities[i].transform.y -= 2 * repulsion_force_y; // Reverse the y-component of the repulsion force
+        if (py[i] < PARTICLE_RADIUS || py[i] > SCREEN_HEIGHT - PARTICLE_RADIUS)
+        {
+            py[i] -= 2 * repulsion_force_y; // Reverse the y-component of the repulsion force
+            repulsion_force_y = -repulsion_force_y;
+        }
+
+        // Keep the displacement that was actually applied this step
+        p.vx[i] = repulsion_force_x;
+        p.vy[i] = repulsion_force_y;
 
         // Apply wave behavior to the y-coordinate
-        float wave_amplitude = WAVE_AMPLITUDE * std::sin(WAVE_FREQUENCY * m_state->entities[i].transform.x);
-        m_state->entities[i].transform.y += wave_amplitude;
+        float wave_amplitude = WAVE_AMPLITUDE * std::sin(WAVE_FREQUENCY * px[i]) * m_step_scale;
+        py[i] += wave_amplitude;
 
         // Ensure particles stay within the screen boundaries
-        if (m_state->entities[i].transform.y < PARTICLE_RADIUS)
-            m_state->entities[i].transform.y = PARTICLE_RADIUS;
-        else if (m_state->entities[i].transform.y > SCREEN_HEIGHT - PARTICLE_RADIUS)
-            m_state->entities[i].transform.y = SCREEN_HEIGHT - PARTICLE_RADIUS;
+        if (py[i] < PARTICLE_RADIUS)
+            py[i] = PARTICLE_RADIUS;
+        else if (py[i] > SCREEN_HEIGHT - PARTICLE_RADIUS)
+            py[i] = SCREEN_HEIGHT - PARTICLE_RADIUS;
+    }
+}
+
+auto simulation::prepare_step(float dt) -> void
+{
+    // At DEFAULT_SIM_RATE_HZ both are exactly the old per step constants
+    m_step_scale = dt * DEFAULT_SIM_RATE_HZ;
+    m_step_damping = std::pow(DAMPING, m_step_scale);
+
+    // Apply input queued by the window thread since the last step
+    {
+        std::lock_guard<std::mutex> lock(m_input_mutex);
+        for (auto& click : m_pending_clicks)
+            spawn_at(click.first, click.second);
+        m_pending_clicks.clear();
+    }
+    bool spacePressed = m_space_pressed.load(std::memory_order_relaxed);
+    if (spacePressed)
+    {
+        SCREEN_WIDTH = 500;
+        SCREEN_HEIGHT = 720;
     }
 
     // Check if it's time to change wave parameters
@@ -198,3 +272,58 @@ auto simulation::update() -> void
         //WAVE_FREQUENCY = m_targetFrequency;
     }
 }
+
+auto simulation::update(float dt) -> void
+{
+    PROFILE_ZONE("simulation::update");
+    prepare_step(dt);
+
+    // Bin entities into repulsion sized cells once per step, from the
+    // positions at the start of the step
+    {
+        PROFILE_ZONE("grid build");
+        m_grid.build(m_state->particles.x, m_state->particles.y, m_state->entity_count, REPULSION_DISTANCE);
+    }
+
+    // Force phase reads neighbours from the grid's start of step snapshot
+    // (old buffer) and each particle only writes its own slot in the
+    // particle store (new buffer), so chunks can run in any order
+    uint32_t count = m_state->entity_count;
+    if (m_workers)
+        m_workers->parallel_for(count, FORCE_CHUNK_SIZE,
+            [this](uint32_t begin, uint32_t end)
+            {
+                PROFILE_ZONE("force chunk");
+                step_range(begin, end);
+            });
+    else
+        step_range(0, count);
+}
+
+auto simulation::gpu_step_params(float dt) -> particle_step_params
+{
+    prepare_step(dt);
+
+    particle_step_params params{};
+    params.screen_width = (float)SCREEN_WIDTH;
+    params.screen_height = (float)SCREEN_HEIGHT;
+    params.step_scale = m_step_scale;
+    params.step_damping = m_step_damping;
+    params.gravity = GRAVITY;
+    params.particle_radius = PARTICLE_RADIUS;
+    params.repulsion_distance = REPULSION_DISTANCE;
+    params.wave_amplitude = WAVE_AMPLITUDE;
+    params.wave_frequency = WAVE_FREQUENCY;
+    params.particle_count = (int)m_state->entity_count;
+    return params;
+}
+
+auto simulation::interaction_radius() -> float
+{
+    return REPULSION_DISTANCE;
+}
+
+auto simulation::memory_bytes() const -> uint64_t
+{
+    return m_state->particles.memory_bytes() + m_grid.memory_bytes();
+}
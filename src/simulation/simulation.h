@@ -1,32 +1,70 @@
 #pragma once
 #include "../engine/defines.h"
 #include "../engine/shared_structs.h"
+#include "particle_store.h"
+#include "force_kernels.h"
+#include "spatial_grid.h"
+#include "../engine/thread_pool.h"
+#include <atomic>
+#include <mutex>
+#include <utility>
 #include <vector>
 #include <GLFW/glfw3.h>
 
-uint32_t constexpr MAX_ENTITIES = 1000;
+uint32_t constexpr INVALID_ENTITY = UINT32_MAX;
 
-struct entity
-{
-	transform transform;
-};
+uint32_t constexpr DEFAULT_SIM_RATE_HZ = 60;
 
 struct simulation_state
 {
-	uint32_t entity_count;
-	entity entities[MAX_ENTITIES];
+	uint32_t entity_count{ 0 };
+	particle_store particles;
+	//how far render time is between the previous and the current step, 0..1
+	float interpolation{ 1.0f };
 };
 
 class simulation
 {
 public:
-	simulation(simulation_state * state, GLFWwindow* window);
+	//workers is optional, without it the step runs on the calling thread.
+	//initial_capacity only sizes the first allocation, storage grows on demand.
+	//window may be null for headless runs, input is ignored then
+	simulation(simulation_state * state, GLFWwindow* window, dazai_engine::thread_pool* workers = nullptr,
+		uint32_t initial_capacity = DEFAULT_ENTITY_CAPACITY);
 	~simulation();
-	auto create_entity(transform transform) -> entity*;
-	auto update() -> void;
+	//returns the index of the new entity or INVALID_ENTITY if storage couldn't grow
+	auto create_entity(transform transform) -> uint32_t;
+	//picks the repulsion kernel, detect_force_kernel() is used by default
+	auto set_force_kernel(force_kernel_type type) -> bool;
+	//advances the simulation by one fixed step of dt seconds
+	auto update(float dt) -> void;
+	//same as update but only returns the step constants for the gpu solver,
+	//the cpu particles are left untouched
+	auto gpu_step_params(float dt) -> particle_step_params;
+	//neighbour search radius, the gpu grid uses it as cell size
+	static auto interaction_radius() -> float;
+	//particle storage plus the neighbour grid
+	auto memory_bytes() const -> uint64_t;
+	//input callbacks run on the window thread, the click is queued and
+	//applied at the start of the next update on the simulation thread
 	auto handleMouseClick(double xpos, double ypos) -> void;
 private:
+	auto spawn_at(double xpos, double ypos) -> void;
+	//input, step constants and wave timing shared by the cpu and gpu paths
+	auto prepare_step(float dt) -> void;
+	auto step_range(uint32_t begin, uint32_t end) -> void;
+
+	//per step constants are tuned for DEFAULT_SIM_RATE_HZ, these rescale them to dt
+	float m_step_scale{ 1.0f };
+	float m_step_damping{ 1.0f };
 
 	simulation_state* m_state;
 	GLFWwindow* m_window;
+	dazai_engine::thread_pool* m_workers;
+	spatial_grid m_grid;
+	force_kernel_fn m_force_kernel;
+	//written by the window thread
+	std::mutex m_input_mutex;
+	std::vector<std::pair<double, double>> m_pending_clicks;
+	std::atomic<bool> m_space_pressed{ false };
 };
\ No newline at end of file
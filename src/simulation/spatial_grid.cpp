@@ -0,0 +1,84 @@
+#include "spatial_grid.h"
+
+auto spatial_grid::build(const float* xs, const float* ys, uint32_t count, float cell_size) -> void
+{
+	//bounds of the current particle set, the grid only covers what is occupied
+	float min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+	if (count > 0)
+	{
+		min_x = max_x = xs[0];
+		min_y = max_y = ys[0];
+	}
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		min_x = xs[i] < min_x ? xs[i] : min_x;
+		max_x = xs[i] > max_x ? xs[i] : max_x;
+		min_y = ys[i] < min_y ? ys[i] : min_y;
+		max_y = ys[i] > max_y ? ys[i] : max_y;
+	}
+	m_min_x = min_x;
+	m_min_y = min_y;
+	m_inv_cell_size = 1.0f / cell_size;
+	float cells_x = (max_x - min_x) * m_inv_cell_size + 1.0f;
+	float cells_y = (max_y - min_y) * m_inv_cell_size + 1.0f;
+	m_cells_x = cells_x < (float)MAX_CELLS_PER_AXIS ? (uint32_t)cells_x : MAX_CELLS_PER_AXIS;
+	m_cells_y = cells_y < (float)MAX_CELLS_PER_AXIS ? (uint32_t)cells_y : MAX_CELLS_PER_AXIS;
+	m_cells_x = m_cells_x > 0 ? m_cells_x : 1;
+	m_cells_y = m_cells_y > 0 ? m_cells_y : 1;
+
+	//counting sort: count per cell, prefix sum, scatter
+	uint32_t cell_count = m_cells_x * m_cells_y;
+	m_cell_start.assign(cell_count + 1, 0);
+	m_cell_entries.resize(count);
+	m_sorted_x.resize(count);
+	m_sorted_y.resize(count);
+	m_entity_cell.resize(count);
+	m_entity_slot.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t cell = (uint32_t)cell_y(ys[i]) * m_cells_x + (uint32_t)cell_x(xs[i]);
+		m_entity_cell[i] = cell;
+		++m_cell_start[cell + 1];
+	}
+	for (uint32_t c = 0; c < cell_count; ++c)
+		m_cell_start[c + 1] += m_cell_start[c];
+	//scatter bumps every cell start to its end, shift back by one afterwards
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t k = m_cell_start[m_entity_cell[i]]++;
+		m_cell_entries[k] = i;
+		m_entity_slot[i] = k;
+		m_sorted_x[k] = xs[i];
+		m_sorted_y[k] = ys[i];
+	}
+	for (uint32_t c = cell_count; c > 0; --c)
+		m_cell_start[c] = m_cell_start[c - 1];
+	m_cell_start[0] = 0;
+}
+
+auto spatial_grid::cell_x(float x) const -> int
+{
+	float f = (x - m_min_x) * m_inv_cell_size;
+	//written so NaN also lands in cell 0
+	if (!(f > 0.0f))
+		return 0;
+	if (f >= (float)(m_cells_x - 1))
+		return (int)m_cells_x - 1;
+	return (int)f;
+}
+
+auto spatial_grid::cell_y(float y) const -> int
+{
+	float f = (y - m_min_y) * m_inv_cell_size;
+	if (!(f > 0.0f))
+		return 0;
+	if (f >= (float)(m_cells_y - 1))
+		return (int)m_cells_y - 1;
+	return (int)f;
+}
+
+auto spatial_grid::memory_bytes() const -> uint64_t
+{
+	return sizeof(uint32_t) * ((uint64_t)m_cell_start.capacity() + m_cell_entries.capacity() +
+		m_entity_cell.capacity() + m_entity_slot.capacity()) + sizeof(float) * ((uint64_t)m_sorted_x.capacity() + m_sorted_y.capacity());
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//uniform grid used to find neighbours within a fixed radius,
+//cell size equals the query radius so only the 3x3 cells around
+//a point need to be visited. rebuilt every step with a counting sort
+class spatial_grid
+{
+public:
+	static constexpr uint32_t NO_ENTITY = UINT32_MAX;
+
+	auto build(const float* xs, const float* ys, uint32_t count, float cell_size) -> void;
+	//bytes reserved by the cell and entity arrays
+	auto memory_bytes() const -> uint64_t;
+
+	//calls fn(xs, ys, count) once per row of the 3x3 cells around (x, y),
+	//xs/ys are the cell ordered positions copied at build time so every
+	//span is contiguous. caller still has to do the exact distance test.
+	//self is an entity index whose own slot is left out of the spans,
+	//pass NO_ENTITY to visit everything
+	template<typename Fn>
+	auto for_each_neighbour_span(float x, float y, uint32_t self, Fn&& fn) const -> void
+	{
+		uint32_t self_slot = self < m_entity_slot.size() ? m_entity_slot[self] : UINT32_MAX;
+		int cx = cell_x(x);
+		int cy = cell_y(y);
+		int min_x = cx > 0 ? cx - 1 : 0;
+		int max_x = cx < (int)m_cells_x - 1 ? cx + 1 : (int)m_cells_x - 1;
+		int min_y = cy > 0 ? cy - 1 : 0;
+		int max_y = cy < (int)m_cells_y - 1 ? cy + 1 : (int)m_cells_y - 1;
+		for (int gy = min_y; gy <= max_y; ++gy)
+		{
+			//cells in a row are contiguous so the whole x range is one span
+			uint32_t row = (uint32_t)gy * m_cells_x;
+			uint32_t begin = m_cell_start[row + min_x];
+			uint32_t end = m_cell_start[row + max_x + 1];
+			//split the span around the entity's own slot
+			if (self_slot >= begin && self_slot < end)
+			{
+				if (self_slot > begin)
+					fn(m_sorted_x.data() + begin, m_sorted_y.data() + begin, self_slot - begin);
+				begin = self_slot + 1;
+			}
+			if (end > begin)
+				fn(m_sorted_x.data() + begin, m_sorted_y.data() + begin, end - begin);
+		}
+	}
+
+private:
+	auto cell_x(float x) const -> int;
+	auto cell_y(float y) const -> int;
+
+	//grid dimension is clamped so stray particles far off screen
+	//can't blow up the cell array, they just share the border cells
+	static constexpr uint32_t MAX_CELLS_PER_AXIS = 1024;
+
+	float m_min_x{ 0.0f };
+	float m_min_y{ 0.0f };
+	float m_inv_cell_size{ 1.0f };
+	uint32_t m_cells_x{ 1 };
+	uint32_t m_cells_y{ 1 };
+	//prefix sum of per cell counts, size = cell count + 1
+	std::vector<uint32_t> m_cell_start;
+	//entity indices sorted by cell
+	std::vector<uint32_t> m_cell_entries;
+	//positions in the same order as m_cell_entries
+	std::vector<float> m_sorted_x;
+	std::vector<float> m_sorted_y;
+	//cell of every entity, cached between the count and scatter passes
+	std::vector<uint32_t> m_entity_cell;
+	//slot of every entity in m_cell_entries, the inverse of it
+	std::vector<uint32_t> m_entity_slot;
+};
@@ -0,0 +1,169 @@
+//packs a scratch directory with tools/asset_packer, reads every asset back
+//through asset_pack and checks that damaged packs are refused by open()
+//usage: test_asset_pack <asset_packer executable>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/engine/asset_pack.h"
+#include "../src/engine/logger.h"
+#include "test_common.h"
+
+dazai_engine::logger g_logger("test_asset_pack_log.txt", false);
+
+using namespace dazai_engine;
+namespace fs = std::filesystem;
+
+namespace
+{
+	auto write_bytes(const fs::path& path, const std::vector<uint8_t>& bytes) -> void
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write((const char*)bytes.data(), bytes.size());
+	}
+
+	auto read_bytes(const fs::path& path) -> std::vector<uint8_t>
+	{
+		std::ifstream in(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	}
+
+	auto run_packer(const char* packer, const fs::path& root, const fs::path& out, bool lz4) -> bool
+	{
+		std::string command = "\"" + std::string(packer) + "\" \"" + root.string() + "\" \"" +
+			out.string() + "\"" + (lz4 ? " --lz4" : "");
+#ifdef _WIN32
+		//cmd strips the outer quotes of the whole line
+		command = "\"" + command + "\"";
+#endif
+		return std::system(command.c_str()) == 0;
+	}
+
+	auto open_bytes(const fs::path& path, const std::vector<uint8_t>& bytes) -> bool
+	{
+		write_bytes(path, bytes);
+		asset_pack pack;
+		return pack.open(path.string().c_str());
+	}
+
+	//index of the first slot that holds an asset
+	auto first_used_slot(const std::vector<uint8_t>& bytes) -> size_t
+	{
+		asset_pack_format::header header;
+		memcpy(&header, bytes.data(), sizeof(header));
+		for (uint32_t s = 0; s < header.slot_count; s++)
+		{
+			asset_pack_format::slot slot;
+			memcpy(&slot, bytes.data() + header.slots_offset + s * sizeof(slot), sizeof(slot));
+			if (slot.name_hash != 0)
+				return header.slots_offset + s * sizeof(slot);
+		}
+		return 0;
+	}
+
+	template<typename T>
+	auto patch(std::vector<uint8_t> bytes, size_t offset, T value) -> std::vector<uint8_t>
+	{
+		memcpy(bytes.data() + offset, &value, sizeof(value));
+		return bytes;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <asset_packer executable>\n", argv[0]);
+		return 1;
+	}
+	fs::path scratch = fs::temp_directory_path() / "dazai_test_asset_pack";
+	fs::remove_all(scratch);
+	fs::path root = scratch / "resources";
+
+	//a mix of what the packer has to handle: compressible, incompressible,
+	//empty and tiny files, nested directories
+	std::mt19937 rng(7);
+	std::map<std::string, std::vector<uint8_t>> assets;
+	std::vector<uint8_t> noise(20000);
+	for (uint8_t& byte : noise)
+		byte = (uint8_t)rng();
+	std::string source;
+	for (int i = 0; i < 300; i++)
+		source += "void main() { gl_Position = vec4(position, 0.0, 1.0); }\n";
+	assets["shaders/default.vert"] = { source.begin(), source.end() };
+	assets["textures/noise.dds"] = noise;
+	assets["textures/empty.dds"] = {};
+	assets["tiny.txt"] = { 'h', 'i' };
+	assets["zeros.bin"] = std::vector<uint8_t>(100000, 0);
+	for (const auto& [name, bytes] : assets)
+		write_bytes(root / name, bytes);
+
+	for (bool lz4 : { false, true })
+	{
+		fs::path pack_path = scratch / (lz4 ? "lz4.pak" : "raw.pak");
+		CHECK(run_packer(argv[1], root, pack_path, lz4));
+		asset_pack pack;
+		CHECK(pack.open(pack_path.string().c_str()));
+		CHECK(pack.entry_count() == assets.size());
+		for (const auto& [name, bytes] : assets)
+		{
+			const asset_pack_format::slot* slot = pack.find(name);
+			CHECK(slot != nullptr);
+			if (slot && lz4 && name == "zeros.bin")
+				CHECK(slot->compression == asset_pack_format::compression_lz4 && slot->stored_size < bytes.size());
+			std::vector<uint8_t> storage;
+			std::span<const uint8_t> out;
+			CHECK(pack.read(name, &storage, &out));
+			CHECK(out.size() == bytes.size() && std::equal(out.begin(), out.end(), bytes.begin()));
+		}
+		CHECK(pack.find("missing.spv") == nullptr);
+		CHECK(pack.find("tiny") == nullptr);
+	}
+
+	//damaged copies of the lz4 pack, each must be refused as a whole
+	std::vector<uint8_t> good = read_bytes(scratch / "lz4.pak");
+	fs::path bad_path = scratch / "bad.pak";
+	CHECK(open_bytes(bad_path, good));
+	{
+		asset_pack_format::header header;
+		memcpy(&header, good.data(), sizeof(header));
+		//cut anywhere from inside the header to one byte short of the last blob
+		for (size_t size : { (size_t)1, sizeof(header) - 1, sizeof(header) + 8,
+			(size_t)header.names_offset, good.size() / 2, good.size() - 1 })
+		{
+			std::vector<uint8_t> truncated(good.begin(), good.begin() + size);
+			CHECK(!open_bytes(bad_path, truncated));
+		}
+
+		CHECK(!open_bytes(bad_path, patch(good, offsetof(asset_pack_format::header, magic), 'X')));
+		CHECK(!open_bytes(bad_path, patch(good, offsetof(asset_pack_format::header, version), 2u)));
+		CHECK(!open_bytes(bad_path, patch(good, offsetof(asset_pack_format::header, slot_count),
+			header.slot_count - 1)));
+		CHECK(!open_bytes(bad_path, patch(good, offsetof(asset_pack_format::header, entry_count),
+			header.entry_count + 1)));
+		CHECK(!open_bytes(bad_path, patch(good, offsetof(asset_pack_format::header, names_size),
+			(uint64_t)good.size())));
+
+		size_t slot = first_used_slot(good);
+		CHECK(slot != 0);
+		CHECK(!open_bytes(bad_path, patch(good, slot + offsetof(asset_pack_format::slot, offset),
+			(uint64_t)good.size())));
+		CHECK(!open_bytes(bad_path, patch(good, slot + offsetof(asset_pack_format::slot, stored_size),
+			(uint64_t)good.size())));
+		CHECK(!open_bytes(bad_path, patch(good, slot + offsetof(asset_pack_format::slot, name_offset),
+			(uint32_t)header.names_size)));
+		CHECK(!open_bytes(bad_path, patch(good, slot + offsetof(asset_pack_format::slot, compression),
+			(uint8_t)7)));
+		//zeroing a used slot's hash empties it, the entry count no longer adds up
+		CHECK(!open_bytes(bad_path, patch(good, slot + offsetof(asset_pack_format::slot, name_hash),
+			(uint64_t)0)));
+	}
+	fs::remove_all(scratch);
+	return test_result();
+}
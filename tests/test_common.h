@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdio>
+
+//tiny check macro for the ctest executables. a failed check prints where
+//it failed and the test keeps going, main returns test_result()
+inline int g_test_failures = 0;
+
+#define CHECK(condition)\
+do\
+{\
+	if (!(condition))\
+	{\
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);\
+		g_test_failures++;\
+	}\
+} while (0)
+
+inline auto test_result() -> int
+{
+	if (g_test_failures > 0)
+		fprintf(stderr, "%d checks failed\n", g_test_failures);
+	return g_test_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+//resources::parse_dds on dds files built in memory: the formats it takes,
+//truncated files, formats it has to refuse and mip counts that don't
+//match the image or the data
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "../src/engine/logger.h"
+#include "../src/engine/resources.h"
+#include "test_common.h"
+
+dazai_engine::logger g_logger("test_dds_log.txt", false);
+
+using namespace dazai_engine;
+
+namespace
+{
+	struct dds_desc
+	{
+		uint32_t width{ 8 };
+		uint32_t height{ 8 };
+		//legacy header, ignored when dxgi_format is set
+		uint32_t pf_flags{ DDPF_FOURCC };
+		uint32_t fourcc{ DDS_FOURCC_DXT1 };
+		uint32_t rgb_bits{ 0 };
+		uint32_t r_mask{ 0 };
+		//0 = no DX10 header
+		uint32_t dxgi_format{ 0 };
+		uint32_t flags{ DDSD_MIPMAPCOUNT };
+		uint32_t mip_count{ 1 };
+		uint64_t pixel_bytes{ 0 };
+	};
+
+	auto make_dds(const dds_desc& desc) -> std::vector<uint8_t>
+	{
+		DDSHeader header{};
+		header.Size = DDS_HEADER_SIZE;
+		header.Flags = desc.flags;
+		header.Width = desc.width;
+		header.Height = desc.height;
+		header.MipMapCount = desc.mip_count;
+		header.ddspf.dwSize = DDS_PIXEL_FORMAT_SIZE;
+		header.ddspf.dwFlags = desc.dxgi_format ? DDPF_FOURCC : desc.pf_flags;
+		header.ddspf.dwFourCC = desc.dxgi_format ? DDS_FOURCC_DX10 : desc.fourcc;
+		header.ddspf.dwRGBBitCount = desc.rgb_bits;
+		header.ddspf.dwRBitMask = desc.r_mask;
+		std::vector<uint8_t> bytes(sizeof(DDS_MAGIC) + sizeof(header));
+		memcpy(bytes.data(), &DDS_MAGIC, sizeof(DDS_MAGIC));
+		memcpy(bytes.data() + sizeof(DDS_MAGIC), &header, sizeof(header));
+		if (desc.dxgi_format)
+		{
+			DDSHeaderDX10 dx10{};
+			dx10.dxgiFormat = desc.dxgi_format;
+			dx10.arraySize = 1;
+			const uint8_t* raw = (const uint8_t*)&dx10;
+			bytes.insert(bytes.end(), raw, raw + sizeof(dx10));
+		}
+		for (uint64_t i = 0; i < desc.pixel_bytes; i++)
+			bytes.push_back((uint8_t)i);
+		return bytes;
+	}
+
+	auto parse(const std::vector<uint8_t>& bytes, dds_texture* out) -> bool
+	{
+		*out = {};
+		return resources::parse_dds({ bytes.data(), bytes.size() }, out);
+	}
+
+	auto parses(const std::vector<uint8_t>& bytes) -> bool
+	{
+		dds_texture texture;
+		return parse(bytes, &texture);
+	}
+}
+
+int main()
+{
+	dds_texture texture;
+
+	//bc1 8x8, full chain: 2x2 blocks, then one block for 4x4, 2x2 and 1x1
+	{
+		dds_desc desc;
+		desc.mip_count = 4;
+		desc.pixel_bytes = 32 + 8 + 8 + 8;
+		std::vector<uint8_t> bytes = make_dds(desc);
+		CHECK(parse(bytes, &texture));
+		CHECK(texture.format == dds_format::bc1 && !texture.srgb);
+		CHECK(texture.width == 8 && texture.height == 8 && texture.mip_count == 4);
+		CHECK(texture.pixel_bytes == 56);
+		CHECK(texture.mips[1].offset == 32 && texture.mips[1].size == 8);
+		CHECK(texture.mips[3].width == 1 && texture.mips[3].height == 1 && texture.mips[3].offset == 48);
+		CHECK(texture.pixels == bytes.data() + sizeof(DDS_MAGIC) + sizeof(DDSHeader));
+
+		//every cut, from an empty file to one byte short of the last mip
+		for (size_t size = 0; size < bytes.size(); size++)
+		{
+			std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + size);
+			CHECK(!parses(truncated));
+		}
+	}
+
+	//dx10 bc7 srgb, non square, rounds partial blocks up
+	{
+		dds_desc desc;
+		desc.width = 16;
+		desc.height = 4;
+		desc.dxgi_format = DXGI_FORMAT_BC7_UNORM_SRGB;
+		desc.mip_count = 5;
+		desc.pixel_bytes = (4 + 2 + 1 + 1 + 1) * 16;
+		std::vector<uint8_t> bytes = make_dds(desc);
+		CHECK(parse(bytes, &texture));
+		CHECK(texture.format == dds_format::bc7 && texture.srgb && texture.mip_count == 5);
+		CHECK(texture.mips[2].width == 4 && texture.mips[2].height == 1 && texture.mips[2].size == 16);
+		CHECK(texture.pixels == bytes.data() + sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10));
+
+		//the dx10 header itself cut short
+		std::vector<uint8_t> truncated(bytes.begin(),
+			bytes.begin() + sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10) - 1);
+		CHECK(!parses(truncated));
+	}
+
+	//odd sizes, 5x3 bc3 is two blocks wide and one high
+	{
+		dds_desc desc;
+		desc.width = 5;
+		desc.height = 3;
+		desc.fourcc = DDS_FOURCC_DXT5;
+		desc.mip_count = 3;
+		desc.pixel_bytes = 2 * 16 + 16 + 16;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.format == dds_format::bc3 && texture.mip_count == 3);
+		CHECK(texture.mips[1].width == 2 && texture.mips[1].height == 1);
+	}
+
+	//uncompressed 32 bit, the red mask decides the byte order
+	{
+		dds_desc desc;
+		desc.width = 4;
+		desc.height = 2;
+		desc.pf_flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		desc.fourcc = 0;
+		desc.rgb_bits = 32;
+		desc.r_mask = 0x000000ff;
+		desc.pixel_bytes = 4 * 2 * 4;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.format == dds_format::rgba8);
+		desc.r_mask = 0x00ff0000;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.format == dds_format::bgra8);
+		desc.pixel_bytes--;
+		CHECK(!parses(make_dds(desc)));
+	}
+
+	//formats the loader doesn't handle
+	{
+		dds_desc dxt3;
+		dxt3.fourcc = 0x33545844;
+		dxt3.pixel_bytes = 1024;
+		CHECK(!parses(make_dds(dxt3)));
+
+		dds_desc float_format;
+		float_format.dxgi_format = 2; // DXGI_FORMAT_R32G32B32A32_FLOAT
+		float_format.pixel_bytes = 1024;
+		CHECK(!parses(make_dds(float_format)));
+
+		dds_desc rgb24;
+		rgb24.pf_flags = DDPF_RGB;
+		rgb24.fourcc = 0;
+		rgb24.rgb_bits = 24;
+		rgb24.pixel_bytes = 1024;
+		CHECK(!parses(make_dds(rgb24)));
+
+		dds_desc luminance;
+		luminance.pf_flags = 0x20000; // DDPF_LUMINANCE
+		luminance.fourcc = 0;
+		luminance.rgb_bits = 8;
+		luminance.pixel_bytes = 1024;
+		CHECK(!parses(make_dds(luminance)));
+	}
+
+	//not a dds at all, or a header that doesn't describe an image
+	{
+		dds_desc desc;
+		desc.pixel_bytes = 32;
+		std::vector<uint8_t> good = make_dds(desc);
+		CHECK(parses(good));
+		std::vector<uint8_t> bad = good;
+		bad[0] = 'X';
+		CHECK(!parses(bad));
+		bad = good;
+		bad[sizeof(DDS_MAGIC)] = 100; // header Size
+		CHECK(!parses(bad));
+		bad = good;
+		bad[sizeof(DDS_MAGIC) + offsetof(DDSHeader, ddspf)] = 24; // ddspf.dwSize
+		CHECK(!parses(bad));
+		desc.width = 0;
+		CHECK(!parses(make_dds(desc)));
+	}
+
+	//mip counts that don't match the image or the data
+	{
+		dds_desc desc;
+		desc.pixel_bytes = 56;
+		//more mips than an 8x8 chain has, clamped to the 4 that exist
+		desc.mip_count = 10;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.mip_count == 4 && texture.pixel_bytes == 56);
+		//count without DDSD_MIPMAPCOUNT, or a zero count, is one level
+		desc.mip_count = 4;
+		desc.flags = 0;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.mip_count == 1 && texture.pixel_bytes == 32);
+		desc.flags = DDSD_MIPMAPCOUNT;
+		desc.mip_count = 0;
+		CHECK(parse(make_dds(desc), &texture));
+		CHECK(texture.mip_count == 1);
+		//the header promises 4 levels but the file only holds 3
+		desc.mip_count = 4;
+		desc.pixel_bytes = 48;
+		CHECK(!parses(make_dds(desc)));
+		//a 64k wide texture has the longest chain parse_dds keeps
+		dds_desc wide;
+		wide.width = 65536;
+		wide.height = 1;
+		wide.mip_count = 40;
+		for (uint32_t m = 0; m < DDS_MAX_MIPS; m++)
+			wide.pixel_bytes += (uint64_t)(((65536 >> m) + 3) / 4) * 8;
+		CHECK(parse(make_dds(wide), &texture));
+		CHECK(texture.mip_count == DDS_MAX_MIPS && texture.mips[DDS_MAX_MIPS - 1].width == 1);
+	}
+	return test_result();
+}
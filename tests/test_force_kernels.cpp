@@ -0,0 +1,107 @@
+//every vector force kernel this cpu can run against repulsion_scalar on
+//random neighbours, with counts that leave a tail after the simd loop
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../src/simulation/force_kernels.h"
+#include "test_common.h"
+
+namespace
+{
+	const force_kernel_type VECTOR_KERNELS[] =
+	{
+		force_kernel_type::sse,
+		force_kernel_type::avx2,
+		force_kernel_type::neon
+	};
+
+	//summation order differs between the kernels, allow a few ulps of the
+	//sum of magnitudes rather than of the (possibly cancelling) result
+	auto close(float value, float reference, float magnitude) -> bool
+	{
+		return std::fabs(value - reference) <= 1e-5f * magnitude + 1e-5f;
+	}
+
+	auto check_kernel(force_kernel_type type, force_kernel_fn kernel, std::mt19937& rng) -> void
+	{
+		force_kernel_fn scalar = get_force_kernel(force_kernel_type::scalar);
+		std::uniform_real_distribution<float> position(0.0f, 100.0f);
+		std::uniform_real_distribution<float> start_force(-50.0f, 50.0f);
+		const float radius = 20.0f;
+		//0..67 covers every tail length for 4 and 8 wide kernels several times
+		for (uint32_t count = 0; count < 68; count++)
+		{
+			for (int round = 0; round < 20; round++)
+			{
+				//one spare float in front so the kernel also sees unaligned input
+				std::vector<float> xs(count + 1);
+				std::vector<float> ys(count + 1);
+				for (uint32_t j = 0; j <= count; j++)
+				{
+					xs[j] = position(rng);
+					ys[j] = position(rng);
+				}
+				float x = position(rng);
+				float y = position(rng);
+				//the kernels accumulate into fx/fy, they must not overwrite it
+				float start_x = start_force(rng);
+				float start_y = start_force(rng);
+				float ref_x = start_x;
+				float ref_y = start_y;
+				scalar(x, y, xs.data() + 1, ys.data() + 1, count, radius, &ref_x, &ref_y);
+				float fx = start_x;
+				float fy = start_y;
+				kernel(x, y, xs.data() + 1, ys.data() + 1, count, radius, &fx, &fy);
+
+				float magnitude = std::fabs(start_x) + std::fabs(start_y);
+				for (uint32_t j = 1; j <= count; j++)
+					magnitude += std::fabs(xs[j] - x) + std::fabs(ys[j] - y);
+				bool ok = close(fx, ref_x, magnitude) && close(fy, ref_y, magnitude);
+				if (!ok)
+				{
+					fprintf(stderr, "%s count %u: (%g, %g) scalar (%g, %g)\n",
+						force_kernel_name(type), count, fx, fy, ref_x, ref_y);
+				}
+				CHECK(ok);
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1234);
+	CHECK(get_force_kernel(force_kernel_type::scalar) != nullptr);
+	//whatever the solver picks on this cpu has to be runnable
+	CHECK(get_force_kernel(detect_force_kernel()) != nullptr);
+
+	//neighbours at the same spot as the particle and right on the radius
+	//contribute nothing on every kernel
+	{
+		float xs[9] = { 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 25.0f };
+		float ys[9] = { 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f, 5.0f };
+		for (int type = 0; type <= (int)force_kernel_type::neon; type++)
+		{
+			force_kernel_fn kernel = get_force_kernel((force_kernel_type)type);
+			if (!kernel)
+				continue;
+			float fx = 0.0f;
+			float fy = 0.0f;
+			kernel(5.0f, 5.0f, xs, ys, 9, 20.0f, &fx, &fy);
+			CHECK(fx == 0.0f && fy == 0.0f);
+		}
+	}
+
+	for (force_kernel_type type : VECTOR_KERNELS)
+	{
+		force_kernel_fn kernel = get_force_kernel(type);
+		if (!kernel)
+		{
+			printf("%s: not available here, skipped\n", force_kernel_name(type));
+			continue;
+		}
+		check_kernel(type, kernel, rng);
+		printf("%s: checked against scalar\n", force_kernel_name(type));
+	}
+	return test_result();
+}
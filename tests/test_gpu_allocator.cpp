@@ -0,0 +1,276 @@
+//gpu_allocator against stubbed vulkan memory calls, no device needed.
+//every VkDeviceMemory is a host buffer so host visible allocations can be
+//written to check that no two of them overlap
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+#include "../src/engine/gpu_allocator.h"
+#include "../src/engine/logger.h"
+#include "test_common.h"
+
+dazai_engine::logger g_logger("test_gpu_allocator_log.txt", false);
+
+using namespace dazai_engine;
+
+namespace
+{
+	struct stub_memory
+	{
+		VkDeviceSize size;
+		uint32_t memory_type;
+		void* host;
+		bool mapped;
+	};
+
+	std::map<uint64_t, stub_memory> g_memory;
+	uint64_t g_next_memory = 1;
+	uint32_t g_max_allocation_count = 4096;
+
+	//type 0 device local, type 1 host visible and coherent
+	constexpr uint32_t DEVICE_LOCAL_TYPE = 0;
+	constexpr uint32_t HOST_VISIBLE_TYPE = 1;
+	constexpr VkMemoryPropertyFlags HOST_VISIBLE =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	constexpr VkDeviceSize BLOCK_SIZE = MB(1);
+
+	auto handle_id(VkDeviceMemory memory) -> uint64_t
+	{
+		return (uint64_t)(uintptr_t)memory;
+	}
+
+	auto requirements(VkDeviceSize size, VkDeviceSize alignment, uint32_t type_bits = 3) -> VkMemoryRequirements
+	{
+		VkMemoryRequirements reqs{};
+		reqs.size = size;
+		reqs.alignment = alignment;
+		reqs.memoryTypeBits = type_bits;
+		return reqs;
+	}
+
+	auto overlaps(const gpu_allocation& a, const gpu_allocation& b) -> bool
+	{
+		return a.memory == b.memory && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+}
+
+extern "C"
+{
+	VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* info,
+		const VkAllocationCallbacks*, VkDeviceMemory* memory)
+	{
+		uint64_t id = g_next_memory++;
+		g_memory[id] = { info->allocationSize, info->memoryTypeIndex, std::malloc((size_t)info->allocationSize), false };
+		*memory = (VkDeviceMemory)(uintptr_t)id;
+		return VK_SUCCESS;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+	{
+		auto it = g_memory.find(handle_id(memory));
+		CHECK(it != g_memory.end() && !it->second.mapped);
+		if (it == g_memory.end())
+			return;
+		std::free(it->second.host);
+		g_memory.erase(it);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset,
+		VkDeviceSize, VkMemoryMapFlags, void** data)
+	{
+		stub_memory& stub = g_memory.at(handle_id(memory));
+		//mapping device local memory or mapping twice is invalid usage
+		CHECK(stub.memory_type == HOST_VISIBLE_TYPE && !stub.mapped);
+		stub.mapped = true;
+		*data = (char*)stub.host + offset;
+		return VK_SUCCESS;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory memory)
+	{
+		stub_memory& stub = g_memory.at(handle_id(memory));
+		CHECK(stub.mapped);
+		stub.mapped = false;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice,
+		VkPhysicalDeviceMemoryProperties* properties)
+	{
+		*properties = {};
+		properties->memoryTypeCount = 2;
+		properties->memoryTypes[DEVICE_LOCAL_TYPE].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		properties->memoryTypes[HOST_VISIBLE_TYPE].propertyFlags = HOST_VISIBLE;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties)
+	{
+		*properties = {};
+		properties->limits.maxMemoryAllocationCount = g_max_allocation_count;
+	}
+}
+
+int main()
+{
+	VkDevice device = (VkDevice)(uintptr_t)1;
+	VkPhysicalDevice physical_device = (VkPhysicalDevice)(uintptr_t)1;
+
+	//small allocations share one block, the block size rounds up to a power of two
+	{
+		gpu_allocator allocator;
+		allocator.init(device, physical_device, BLOCK_SIZE - 1000);
+		gpu_allocation a = allocator.allocate(requirements(100, 4), HOST_VISIBLE, true);
+		gpu_allocation b = allocator.allocate(requirements(100, 4), HOST_VISIBLE, true);
+		CHECK(a.memory != VK_NULL_HANDLE && a.memory == b.memory);
+		CHECK(!overlaps(a, b));
+		CHECK(a.data != nullptr && b.data == (char*)a.data - a.offset + b.offset);
+		CHECK(g_memory.size() == 1 && g_memory.begin()->second.size == BLOCK_SIZE);
+		gpu_allocator_stats stats = allocator.get_stats();
+		CHECK(stats.block_count == 1 && stats.allocation_count == 2 && stats.bytes_used == 200);
+
+		//device local memory is never mapped, images get their own blocks
+		gpu_allocation image = allocator.allocate(requirements(100, 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		gpu_allocation linear = allocator.allocate(requirements(100, 4, 1), 0, true);
+		CHECK(image.memory != VK_NULL_HANDLE && image.data == nullptr);
+		CHECK(linear.memory != VK_NULL_HANDLE && linear.memory != image.memory && linear.memory != a.memory);
+		CHECK(g_memory.at(handle_id(image.memory)).memory_type == DEVICE_LOCAL_TYPE);
+
+		//no memory type has the properties, nothing is allocated
+		gpu_allocation none = allocator.allocate(requirements(100, 4, 1), HOST_VISIBLE, true);
+		CHECK(none.memory == VK_NULL_HANDLE);
+
+		allocator.free(&a);
+		allocator.free(&b);
+		allocator.free(&image);
+		allocator.free(&linear);
+		CHECK(a.memory == VK_NULL_HANDLE);
+		stats = allocator.get_stats();
+		CHECK(stats.allocation_count == 0 && stats.bytes_used == 0 && stats.fragmentation == 0.0f);
+		allocator.destroy();
+		CHECK(g_memory.empty());
+	}
+
+	//random sizes and alignments, every range aligned and disjoint and
+	//its bytes untouched by the others
+	{
+		gpu_allocator allocator;
+		allocator.init(device, physical_device, BLOCK_SIZE);
+		std::mt19937 rng(5);
+		std::vector<gpu_allocation> live;
+		std::vector<uint8_t> tags;
+		for (int step = 0; step < 5000; step++)
+		{
+			if (live.size() < 300 && rng() % 3 != 0)
+			{
+				VkDeviceSize size = 1 + rng() % 40000;
+				VkDeviceSize alignment = (VkDeviceSize)1 << (rng() % 17);
+				gpu_allocation allocation = allocator.allocate(requirements(size, alignment), HOST_VISIBLE, true);
+				CHECK(allocation.memory != VK_NULL_HANDLE);
+				CHECK(allocation.offset % alignment == 0);
+				for (const gpu_allocation& other : live)
+					CHECK(!overlaps(allocation, other));
+				uint8_t tag = (uint8_t)(step | 1);
+				memset(allocation.data, tag, (size_t)size);
+				live.push_back(allocation);
+				tags.push_back(tag);
+			}
+			else if (!live.empty())
+			{
+				size_t k = rng() % live.size();
+				const uint8_t* bytes = (const uint8_t*)live[k].data;
+				CHECK(std::all_of(bytes, bytes + live[k].size, [&](uint8_t b) { return b == tags[k]; }));
+				allocator.free(&live[k]);
+				live.erase(live.begin() + k);
+				tags.erase(tags.begin() + k);
+			}
+		}
+		for (gpu_allocation& allocation : live)
+			allocator.free(&allocation);
+		//everything coalesced back, each block is one free range again
+		gpu_allocator_stats stats = allocator.get_stats();
+		CHECK(stats.allocation_count == 0 && stats.bytes_used == 0 && stats.fragmentation == 0.0f);
+		allocator.destroy();
+		CHECK(g_memory.empty());
+	}
+
+	//buddies merge on free, a freed block serves a whole block request again
+	{
+		gpu_allocator allocator;
+		allocator.init(device, physical_device, BLOCK_SIZE);
+		gpu_allocation quarters[4];
+		for (gpu_allocation& quarter : quarters)
+			quarter = allocator.allocate(requirements(BLOCK_SIZE / 4, 256), HOST_VISIBLE, true);
+		CHECK(g_memory.size() == 1);
+		VkDeviceMemory first = quarters[0].memory;
+
+		//two free quarters that aren't buddies, half the free space is outside the largest range
+		allocator.free(&quarters[0]);
+		allocator.free(&quarters[2]);
+		CHECK(allocator.get_stats().fragmentation == 0.5f);
+		gpu_allocation half = allocator.allocate(requirements(BLOCK_SIZE / 2, 256), HOST_VISIBLE, true);
+		CHECK(half.memory != first);
+		CHECK(g_memory.size() == 2);
+		allocator.free(&half);
+
+		//freeing quarter 1 merges 0 and 1 into the lower half
+		allocator.free(&quarters[1]);
+		half = allocator.allocate(requirements(BLOCK_SIZE / 2, 256), HOST_VISIBLE, true);
+		CHECK(half.memory == first && half.offset == 0);
+		allocator.free(&half);
+		allocator.free(&quarters[3]);
+
+		gpu_allocation whole = allocator.allocate(requirements(BLOCK_SIZE, BLOCK_SIZE), HOST_VISIBLE, true);
+		CHECK(whole.memory != VK_NULL_HANDLE && whole.offset == 0);
+		CHECK(g_memory.size() == 2);
+		allocator.free(&whole);
+		allocator.destroy();
+	}
+
+	//anything bigger than a block gets dedicated memory of exactly its size,
+	//released as soon as it is freed
+	{
+		gpu_allocator allocator;
+		allocator.init(device, physical_device, BLOCK_SIZE);
+		gpu_allocation small = allocator.allocate(requirements(1000, 256), HOST_VISIBLE, true);
+		VkDeviceSize big_size = BLOCK_SIZE * 3 + 12345;
+		gpu_allocation big = allocator.allocate(requirements(big_size, 4096), HOST_VISIBLE, true);
+		CHECK(big.memory != VK_NULL_HANDLE && big.memory != small.memory && big.offset == 0);
+		CHECK(g_memory.at(handle_id(big.memory)).size == big_size);
+		CHECK(big.data != nullptr);
+		memset(big.data, 0xab, (size_t)big_size);
+		CHECK(allocator.get_stats().block_count == 2);
+		uint64_t big_id = handle_id(big.memory);
+		allocator.free(&big);
+		CHECK(g_memory.count(big_id) == 0);
+		CHECK(allocator.get_stats().block_count == 1);
+
+		//small allocations never land in a dedicated block
+		gpu_allocation big_again = allocator.allocate(requirements(big_size, 4096), HOST_VISIBLE, true);
+		gpu_allocation small_again = allocator.allocate(requirements(1000, 256), HOST_VISIBLE, true);
+		CHECK(small_again.memory == small.memory);
+		allocator.free(&big_again);
+		allocator.free(&small_again);
+		allocator.free(&small);
+		allocator.destroy();
+		CHECK(g_memory.empty());
+	}
+
+	//maxMemoryAllocationCount caps the number of blocks, past it allocate fails
+	{
+		g_max_allocation_count = 2;
+		gpu_allocator allocator;
+		allocator.init(device, physical_device, BLOCK_SIZE);
+		gpu_allocation a = allocator.allocate(requirements(BLOCK_SIZE, 256), HOST_VISIBLE, true);
+		gpu_allocation b = allocator.allocate(requirements(BLOCK_SIZE, 256), HOST_VISIBLE, true);
+		gpu_allocation c = allocator.allocate(requirements(BLOCK_SIZE, 256), HOST_VISIBLE, true);
+		CHECK(a.memory != VK_NULL_HANDLE && b.memory != VK_NULL_HANDLE);
+		CHECK(c.memory == VK_NULL_HANDLE);
+		CHECK(g_memory.size() == 2);
+		allocator.free(&c);
+		allocator.destroy();
+		CHECK(g_memory.empty());
+		g_max_allocation_count = 4096;
+	}
+	return test_result();
+}
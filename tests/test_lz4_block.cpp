@@ -0,0 +1,130 @@
+//lz4_block round trips over the inputs the packer actually sees and the
+//edge cases of the format, plus decompress rejecting broken blocks
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../src/engine/lz4_block.h"
+#include "test_common.h"
+
+using namespace dazai_engine;
+
+namespace
+{
+	//MATCH_FIND_LIMIT in lz4_block.cpp, inputs up to it are all literals
+	constexpr size_t MATCH_FIND_LIMIT = 12;
+
+	auto round_trip(const std::vector<uint8_t>& input) -> bool
+	{
+		std::vector<uint8_t> packed(lz4_block::compress_bound(input.size()));
+		size_t packed_size = lz4_block::compress(input.data(), input.size(), packed.data(), packed.size());
+		if (packed_size == 0 || packed_size > packed.size())
+		{
+			fprintf(stderr, "compress failed, %zu bytes\n", input.size());
+			return false;
+		}
+		std::vector<uint8_t> output(input.size());
+		if (!lz4_block::decompress(packed.data(), packed_size, output.data(), output.size()) ||
+			output != input)
+		{
+			fprintf(stderr, "round trip failed, %zu bytes\n", input.size());
+			return false;
+		}
+		return true;
+	}
+
+	auto random_bytes(std::mt19937& rng, size_t size) -> std::vector<uint8_t>
+	{
+		std::vector<uint8_t> bytes(size);
+		for (uint8_t& byte : bytes)
+			byte = (uint8_t)rng();
+		return bytes;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(99);
+
+	//empty input is a single empty literal run
+	{
+		std::vector<uint8_t> packed(lz4_block::compress_bound(0));
+		size_t packed_size = lz4_block::compress(nullptr, 0, packed.data(), packed.size());
+		CHECK(packed_size == 1);
+		CHECK(lz4_block::decompress(packed.data(), packed_size, nullptr, 0));
+		CHECK(round_trip({}));
+	}
+
+	//short inputs around the point where the matcher starts looking
+	for (size_t size = 1; size <= MATCH_FIND_LIMIT + 4; size++)
+	{
+		CHECK(round_trip(random_bytes(rng, size)));
+		CHECK(round_trip(std::vector<uint8_t>(size, 'a')));
+	}
+
+	//incompressible data only grows by the literal length bytes
+	for (size_t size : { 15, 16, 270, 271, 4096, 100000 })
+	{
+		std::vector<uint8_t> input = random_bytes(rng, size);
+		CHECK(round_trip(input));
+		std::vector<uint8_t> packed(lz4_block::compress_bound(size));
+		CHECK(lz4_block::compress(input.data(), size, packed.data(), packed.size()) <= lz4_block::compress_bound(size));
+	}
+
+	//long runs need continued match lengths, repeats a full window back
+	//use the largest offset
+	{
+		std::vector<uint8_t> zeros(200000, 0);
+		CHECK(round_trip(zeros));
+		std::vector<uint8_t> packed(lz4_block::compress_bound(zeros.size()));
+		CHECK(lz4_block::compress(zeros.data(), zeros.size(), packed.data(), packed.size()) < 2000);
+
+		std::vector<uint8_t> far = random_bytes(rng, 65535);
+		std::vector<uint8_t> repeat(far.begin(), far.begin() + 5000);
+		far.insert(far.end(), repeat.begin(), repeat.end());
+		CHECK(round_trip(far));
+
+		std::vector<uint8_t> text;
+		const char* line = "layout(location = 0) in vec2 position;\n";
+		for (int i = 0; i < 500; i++)
+			text.insert(text.end(), line, line + strlen(line));
+		CHECK(round_trip(text));
+	}
+
+	//a block written by hand from the format description, one literal, a
+	//match overlapping its own output, then the last literals
+	{
+		const uint8_t block[] = { 0x11, 'a', 0x01, 0x00, 0x50, 'b', 'b', 'b', 'b', 'b' };
+		const char expected[] = "aaaaaabbbbb";
+		uint8_t output[11];
+		CHECK(lz4_block::decompress(block, sizeof(block), output, sizeof(output)));
+		CHECK(memcmp(output, expected, sizeof(output)) == 0);
+	}
+
+	//compress reports 0 instead of writing past a small output
+	{
+		std::vector<uint8_t> input = random_bytes(rng, 1000);
+		std::vector<uint8_t> packed(500);
+		CHECK(lz4_block::compress(input.data(), input.size(), packed.data(), packed.size()) == 0);
+	}
+
+	//decompress rejects anything that doesn't produce exactly dst_size bytes
+	{
+		std::vector<uint8_t> input(5000);
+		for (size_t i = 0; i < input.size(); i++)
+			input[i] = (uint8_t)(i % 61);
+		std::vector<uint8_t> packed(lz4_block::compress_bound(input.size()));
+		size_t packed_size = lz4_block::compress(input.data(), input.size(), packed.data(), packed.size());
+		std::vector<uint8_t> output(input.size() + 1);
+		CHECK(!lz4_block::decompress(packed.data(), packed_size, output.data(), input.size() - 1));
+		CHECK(!lz4_block::decompress(packed.data(), packed_size, output.data(), input.size() + 1));
+		for (size_t cut = 1; cut < packed_size; cut += 7)
+			CHECK(!lz4_block::decompress(packed.data(), packed_size - cut, output.data(), input.size()));
+
+		//offset 0 and an offset before the start of the output
+		const uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00, 0x50, 'b', 'b', 'b', 'b', 'b' };
+		const uint8_t far_offset[] = { 0x10, 'a', 0x02, 0x00, 0x50, 'b', 'b', 'b', 'b', 'b' };
+		CHECK(!lz4_block::decompress(zero_offset, sizeof(zero_offset), output.data(), 10));
+		CHECK(!lz4_block::decompress(far_offset, sizeof(far_offset), output.data(), 10));
+	}
+	return test_result();
+}
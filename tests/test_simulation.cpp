@@ -0,0 +1,76 @@
+//headless simulation steps checking that a particle never repels itself,
+//the grid holds start of step positions while the solver queries with the
+//position gravity has already moved
+#include <cmath>
+#include "../src/engine/logger.h"
+#include "../src/simulation/simulation.h"
+#include "test_common.h"
+
+dazai_engine::logger g_logger("test_simulation_log.txt", false);
+
+namespace
+{
+	const force_kernel_type ALL_KERNELS[] =
+	{
+		force_kernel_type::scalar,
+		force_kernel_type::sse,
+		force_kernel_type::avx2,
+		force_kernel_type::neon
+	};
+
+	auto make_transform(float x, float y) -> transform
+	{
+		transform t{};
+		t.x = x;
+		t.y = y;
+		t.size_x = 30;
+		t.size_y = 30;
+		return t;
+	}
+
+	auto check_isolated(force_kernel_type type) -> void
+	{
+		//capacity 1 spawns no random particles
+		simulation_state state{};
+		simulation sim(&state, nullptr, nullptr, 1);
+		sim.set_force_kernel(type);
+		sim.create_entity(make_transform(100.0f, 30.0f));
+		for (int step = 0; step < 5; step++)
+		{
+			sim.update(1.0f / DEFAULT_SIM_RATE_HZ);
+			CHECK(state.particles.vx[0] == 0.0f);
+			CHECK(state.particles.vy[0] == 0.0f);
+		}
+		CHECK(state.particles.x[0] == 100.0f);
+	}
+
+	auto check_pair(force_kernel_type type) -> void
+	{
+		//side by side at the same height, gravity moves both the same way
+		//so they push apart horizontally by the same amount
+		simulation_state state{};
+		simulation sim(&state, nullptr, nullptr, 1);
+		sim.set_force_kernel(type);
+		sim.create_entity(make_transform(100.0f, 30.0f));
+		sim.create_entity(make_transform(110.0f, 30.0f));
+		sim.update(1.0f / DEFAULT_SIM_RATE_HZ);
+		const particle_store& p = state.particles;
+		CHECK(p.vx[0] < 0.0f);
+		CHECK(p.vx[1] > 0.0f);
+		CHECK(std::fabs(p.vx[0] + p.vx[1]) <= 1e-5f);
+		CHECK(std::fabs(p.vy[0] - p.vy[1]) <= 1e-5f);
+	}
+}
+
+int main()
+{
+	for (force_kernel_type type : ALL_KERNELS)
+	{
+		if (!get_force_kernel(type))
+			continue;
+		check_isolated(type);
+		check_pair(type);
+		printf("%s: checked\n", force_kernel_name(type));
+	}
+	return test_result();
+}
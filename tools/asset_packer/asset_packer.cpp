@@ -0,0 +1,175 @@
+// Packs loose assets into one file for asset_pack / resources::mount_pack
+// usage: asset_packer <resources dir> <out.pak> [--lz4] [--ext <.spv>]...
+// names are paths relative to the resources dir with forward slashes, the same
+// strings the engine passes to resources::load_asset. --lz4 compresses every
+// asset that gets smaller, --ext (repeatable) only packs files with that extension
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../../src/engine/asset_pack_format.h"
+#include "../../src/engine/lz4_block.h"
+
+using namespace dazai_engine;
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct asset
+	{
+		std::string name;
+		std::vector<uint8_t> data;
+		uint64_t size;
+		asset_pack_format::compression compression;
+	};
+
+	auto align_up(uint64_t value, uint64_t alignment) -> uint64_t
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	auto wanted(const fs::path& path, const std::vector<std::string>& extensions) -> bool
+	{
+		if (extensions.empty())
+			return true;
+		std::string extension = path.extension().string();
+		return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <resources dir> <out.pak> [--lz4] [--ext <.spv>]...\n", argv[0]);
+		return 1;
+	}
+	fs::path root = argv[1];
+	fs::path out_path = argv[2];
+	bool lz4 = false;
+	std::vector<std::string> extensions;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--lz4") == 0)
+			lz4 = true;
+		else if (strcmp(argv[i], "--ext") == 0 && i + 1 < argc)
+			extensions.push_back(argv[++i]);
+	}
+	std::error_code error;
+	if (!fs::is_directory(root, error))
+	{
+		fprintf(stderr, "%s is not a directory\n", argv[1]);
+		return 1;
+	}
+
+	std::vector<asset> assets;
+	for (const auto& file : fs::recursive_directory_iterator(root))
+	{
+		if (!file.is_regular_file() || !wanted(file.path(), extensions))
+			continue;
+		//a previous pack written into the tree must not end up inside the new one
+		if (fs::equivalent(file.path(), out_path, error))
+			continue;
+		asset entry{};
+		entry.name = fs::relative(file.path(), root).generic_string();
+		if (entry.name.size() > UINT16_MAX)
+		{
+			fprintf(stderr, "name too long: %s\n", entry.name.c_str());
+			return 1;
+		}
+		std::ifstream in(file.path(), std::ios::binary);
+		if (!in)
+		{
+			fprintf(stderr, "can't open %s\n", file.path().string().c_str());
+			return 1;
+		}
+		entry.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		entry.size = entry.data.size();
+		entry.compression = asset_pack_format::compression_none;
+		if (lz4 && !entry.data.empty())
+		{
+			std::vector<uint8_t> packed(lz4_block::compress_bound(entry.data.size()));
+			size_t packed_size = lz4_block::compress(entry.data.data(), entry.data.size(),
+				packed.data(), packed.size());
+			if (packed_size > 0 && packed_size < entry.data.size())
+			{
+				packed.resize(packed_size);
+				entry.data = std::move(packed);
+				entry.compression = asset_pack_format::compression_lz4;
+			}
+		}
+		assets.push_back(std::move(entry));
+	}
+	//same input, same pack
+	std::sort(assets.begin(), assets.end(),
+		[](const asset& a, const asset& b) { return a.name < b.name; });
+
+	uint32_t slot_count = 1;
+	while (slot_count < assets.size() * 2 + 1)
+		slot_count <<= 1;
+	asset_pack_format::header header{};
+	memcpy(header.magic, asset_pack_format::MAGIC, sizeof(header.magic));
+	header.version = asset_pack_format::VERSION;
+	header.entry_count = (uint32_t)assets.size();
+	header.slot_count = slot_count;
+	header.alignment = asset_pack_format::DEFAULT_ALIGNMENT;
+	header.slots_offset = sizeof(header);
+	header.names_offset = header.slots_offset + sizeof(asset_pack_format::slot) * slot_count;
+	for (const auto& entry : assets)
+		header.names_size += entry.name.size();
+
+	std::vector<asset_pack_format::slot> slots(slot_count);
+	std::string names;
+	uint64_t offset = align_up(header.names_offset + header.names_size, header.alignment);
+	uint64_t raw_bytes = 0;
+	for (const auto& entry : assets)
+	{
+		uint64_t hash = asset_pack_format::hash_name(entry.name);
+		uint32_t s = (uint32_t)hash & (slot_count - 1);
+		while (slots[s].name_hash != 0)
+			s = (s + 1) & (slot_count - 1);
+		asset_pack_format::slot& slot = slots[s];
+		slot.name_hash = hash;
+		slot.offset = offset;
+		slot.stored_size = entry.data.size();
+		slot.size = entry.size;
+		slot.name_offset = (uint32_t)names.size();
+		slot.name_length = (uint16_t)entry.name.size();
+		slot.compression = entry.compression;
+		names += entry.name;
+		offset = align_up(offset + entry.data.size(), header.alignment);
+		raw_bytes += entry.size;
+	}
+
+	std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		fprintf(stderr, "can't open %s\n", argv[2]);
+		return 1;
+	}
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)slots.data(), sizeof(asset_pack_format::slot) * slots.size());
+	out.write(names.data(), names.size());
+	static const char padding[asset_pack_format::DEFAULT_ALIGNMENT] = {};
+	uint64_t written = header.names_offset + header.names_size;
+	for (const auto& entry : assets)
+	{
+		uint64_t start = align_up(written, header.alignment);
+		out.write(padding, start - written);
+		out.write((const char*)entry.data.data(), entry.data.size());
+		written = start + entry.data.size();
+	}
+	if (!out)
+	{
+		fprintf(stderr, "write to %s failed\n", argv[2]);
+		return 1;
+	}
+	fprintf(stderr, "%zu assets, %" PRIu64 " bytes packed into %" PRIu64 "\n",
+		assets.size(), raw_bytes, written);
+	return 0;
+}
@@ -0,0 +1,211 @@
+// Turns a binary log written by logger::open_binary back into the text format
+// usage: log_decoder <log.bin> [out.txt]
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../src/engine/binary_log.h"
+
+using namespace dazai_engine;
+
+namespace
+{
+	struct site
+	{
+		uint8_t level;
+		uint32_t line;
+		std::string file;
+	};
+
+	//bounds checked little endian reader over the whole file
+	struct reader
+	{
+		const std::vector<char>& data;
+		size_t offset;
+
+		auto remaining() const -> size_t
+		{
+			return data.size() - offset;
+		}
+
+		template<typename T>
+		auto get(T& value) -> bool
+		{
+			if (remaining() < sizeof(T))
+				return false;
+			memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+
+		auto get_bytes(std::string& out, size_t length) -> bool
+		{
+			if (remaining() < length)
+				return false;
+			out.assign(data.data() + offset, length);
+			offset += length;
+			return true;
+		}
+	};
+
+	auto level_name(uint8_t level) -> const char*
+	{
+		switch (level)
+		{
+		case 0: return "INFO";
+		case 1: return "WARNING";
+		case 2: return "ERROR";
+		case 3: return "VK_VALIDATION";
+		}
+		return "UNKNOWN";
+	}
+
+	auto read_site(reader& in, std::unordered_map<uint32_t, site>& sites) -> bool
+	{
+		uint32_t id;
+		site s{};
+		uint16_t file_length;
+		if (!in.get(id) || !in.get(s.level) || !in.get(s.line) ||
+			!in.get(file_length) || !in.get_bytes(s.file, file_length))
+			return false;
+		sites[id] = s;
+		return true;
+	}
+
+	//formats one log_record, arguments separated by spaces like the text logger
+	auto read_record(reader& in, std::string& text) -> bool
+	{
+		uint8_t arg_count;
+		if (!in.get(arg_count))
+			return false;
+		char number[32];
+		for (uint8_t a = 0; a < arg_count; a++)
+		{
+			uint8_t type;
+			if (!in.get(type))
+				return false;
+			if (a > 0)
+				text += " ";
+			if (type == binary_log::arg_string)
+			{
+				uint32_t length;
+				std::string str;
+				if (!in.get(length) || !in.get_bytes(str, length))
+					return false;
+				text += str;
+				continue;
+			}
+			uint64_t bits;
+			if (!in.get(bits))
+				return false;
+			switch (type)
+			{
+			case binary_log::arg_int:
+				snprintf(number, sizeof(number), "%" PRId64, (int64_t)bits);
+				break;
+			case binary_log::arg_uint:
+				snprintf(number, sizeof(number), "%" PRIu64, bits);
+				break;
+			case binary_log::arg_double:
+			{
+				double value;
+				memcpy(&value, &bits, sizeof(value));
+				//same 6 significant digits as the default ostream format
+				snprintf(number, sizeof(number), "%g", value);
+				break;
+			}
+			case binary_log::arg_pointer:
+				snprintf(number, sizeof(number), "0x%" PRIx64, bits);
+				break;
+			default:
+				return false;
+			}
+			text += number;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <log.bin> [out.txt]\n", argv[0]);
+		return 1;
+	}
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file)
+	{
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 1;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < sizeof(binary_log::MAGIC) ||
+		memcmp(data.data(), binary_log::MAGIC, sizeof(binary_log::MAGIC)) != 0)
+	{
+		fprintf(stderr, "%s is not a binary log\n", argv[1]);
+		return 1;
+	}
+	std::ofstream out_file;
+	if (argc > 2)
+		out_file.open(argv[2]);
+	std::ostream& out = argc > 2 ? out_file : std::cout;
+
+	//a site can be defined after its first records, collect all of them first
+	std::unordered_map<uint32_t, site> sites;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		reader in{ data, sizeof(binary_log::MAGIC) };
+		uint64_t records = 0;
+		while (in.remaining() > 0)
+		{
+			uint8_t tag;
+			in.get(tag);
+			bool ok = true;
+			if (tag == binary_log::site_record)
+			{
+				ok = read_site(in, sites);
+			}
+			else if (tag == binary_log::log_record)
+			{
+				uint32_t id;
+				std::string text;
+				ok = in.get(id) && read_record(in, text);
+				if (ok && pass == 1)
+				{
+					auto it = sites.find(id);
+					if (it != sites.end())
+						out << text << "[" << level_name(it->second.level) << "] "
+						<< it->second.file << ":" << it->second.line << "\n";
+					else
+						out << text << "[UNKNOWN] site " << id << "\n";
+				}
+				records++;
+			}
+			else if (tag == binary_log::drop_record)
+			{
+				uint64_t dropped;
+				ok = in.get(dropped);
+				if (ok && pass == 1)
+					out << "[WARNING] logger dropped " << dropped << " records\n";
+			}
+			else
+			{
+				ok = false;
+			}
+			if (!ok)
+			{
+				//a crash can leave a partial record at the end
+				fprintf(stderr, "corrupt or truncated record at byte %zu\n", in.offset);
+				break;
+			}
+		}
+		if (pass == 1)
+			fprintf(stderr, "%" PRIu64 " records, %zu call sites\n", records, sites.size());
+	}
+	return 0;
+}